@@ -3,7 +3,8 @@
 
 enum
 {
-	SDKSTLEXPORTFILTER_SCALE		 				= 2000
+	SDKSTLEXPORTFILTER_SCALE		 				= 2000,
+	SDKSTLEXPORTFILTER_ASCII						= 2001
 };
 
 #endif // FSDKSTLEXPORT_H__
@@ -6,5 +6,6 @@ CONTAINER Fsdkstlexport
 	GROUP ID_FILTERPROPERTIES
 	{
 		UNITSCALE SDKSTLEXPORTFILTER_SCALE	{ }
+		BOOL SDKSTLEXPORTFILTER_ASCII { }
 	}
 }
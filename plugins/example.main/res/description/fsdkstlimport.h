@@ -3,7 +3,9 @@
 
 enum
 {
-	SDKSTLIMPORTFILTER_SCALE		 				= 2000
+	SDKSTLIMPORTFILTER_SCALE		 				= 2000,
+	SDKSTLIMPORTFILTER_WELD_TOLERANCE		= 2001,
+	SDKSTLIMPORTFILTER_MEMORY_LIMIT			= 2002
 };
 
 #endif // FSDKSTLIMPORT_H__
@@ -6,5 +6,7 @@ CONTAINER Fsdkstlimport
 	GROUP ID_FILTERPROPERTIES
 	{
 		UNITSCALE SDKSTLIMPORTFILTER_SCALE	{ }
+		REAL SDKSTLIMPORTFILTER_WELD_TOLERANCE { UNIT METER; MIN 0.0; }
+		LONG SDKSTLIMPORTFILTER_MEMORY_LIMIT { MIN 0; }
 	}
 }
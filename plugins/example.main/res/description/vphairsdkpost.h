@@ -3,6 +3,9 @@
 
 enum
 {
+	HAIRSDKPOST_SHADOW_CACHE				= 1000,
+	HAIRSDKPOST_SHADOW_CACHE_CELL		= 1001,
+
 	//////////////////////////////////////////////////////////////////////////
 
 	_HAIR_POST_END_
@@ -1,4 +1,11 @@
 CONTAINER Vphairsdkpost
 {
 	NAME Vphairsdkpost;
-}
\ No newline at end of file
+	INCLUDE VPbase;
+
+	GROUP ID_VIDEOPOSTPROPERTIES
+	{
+		BOOL HAIRSDKPOST_SHADOW_CACHE { }
+		REAL HAIRSDKPOST_SHADOW_CACHE_CELL { UNIT METER; MIN 0.001; }
+	}
+}
@@ -0,0 +1,9 @@
+#ifndef VPINVERTIMAGE_H__
+#define VPINVERTIMAGE_H__
+
+enum
+{
+	VP_INVERTIMAGE_FUSE				= 1000
+};
+
+#endif // VPINVERTIMAGE_H__
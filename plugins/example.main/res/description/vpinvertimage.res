@@ -0,0 +1,10 @@
+CONTAINER VPinvertimage
+{
+	NAME VPinvertimage;
+	INCLUDE VPbase;
+
+	GROUP ID_VIDEOPOSTPROPERTIES
+	{
+		BOOL VP_INVERTIMAGE_FUSE { }
+	}
+}
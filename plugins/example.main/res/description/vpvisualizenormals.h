@@ -0,0 +1,9 @@
+#ifndef VPVISUALIZENORMALS_H__
+#define VPVISUALIZENORMALS_H__
+
+enum
+{
+	VP_VISUALIZENORMALS_FUSE	= 1000
+};
+
+#endif // VPVISUALIZENORMALS_H__
@@ -0,0 +1,10 @@
+CONTAINER VPvisualizenormals
+{
+	NAME VPvisualizenormals;
+	INCLUDE VPbase;
+
+	GROUP ID_VIDEOPOSTPROPERTIES
+	{
+		BOOL VP_VISUALIZENORMALS_FUSE { }
+	}
+}
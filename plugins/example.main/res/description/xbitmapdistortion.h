@@ -6,7 +6,8 @@ enum
 	BITMAPDISTORTIONSHADER_NOISE 		= 1000,
 	BITMAPDISTORTIONSHADER_OCTAVES	= 1001,
 	BITMAPDISTORTIONSHADER_SCALE		= 1002,
-	BITMAPDISTORTIONSHADER_TEXTURE	= 1003
+	BITMAPDISTORTIONSHADER_TEXTURE	= 1003,
+	BITMAPDISTORTIONSHADER_CACHE		= 1004
 };
 
 #endif // XBITMAPDISTORTION_H__
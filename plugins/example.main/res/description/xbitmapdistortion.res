@@ -11,5 +11,6 @@ CONTAINER Xbitmapdistortion
 		REAL BITMAPDISTORTIONSHADER_OCTAVES	{ MIN 0.0; MAX 10.0; STEP 0.01; }
 		REAL BITMAPDISTORTIONSHADER_SCALE		{ UNIT PERCENT; MIN 0.0; MAX 1000.0; STEP 0.1; }
 		SHADERLINK BITMAPDISTORTIONSHADER_TEXTURE { }
+		BOOL BITMAPDISTORTIONSHADER_CACHE { }
 	}
 }
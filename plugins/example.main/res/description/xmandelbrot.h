@@ -4,7 +4,8 @@
 enum
 {
 	MANDELBROTSHADER_COLOROFFSET	= 1000,
-	MANDELBROTSHADER_OBJECTACCESS	= 1001
+	MANDELBROTSHADER_OBJECTACCESS	= 1001,
+	MANDELBROTSHADER_BAKE					= 1002
 };
 
 #endif // XMANDELBROT_H__
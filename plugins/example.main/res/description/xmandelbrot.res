@@ -9,5 +9,6 @@ CONTAINER Xmandelbrot
 	{
 		LONG MANDELBROTSHADER_COLOROFFSET { MIN 0; MAX 100; }
 		BOOL MANDELBROTSHADER_OBJECTACCESS { }
+		BOOL MANDELBROTSHADER_BAKE { }
 	}
 }
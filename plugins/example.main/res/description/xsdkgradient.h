@@ -20,7 +20,9 @@ enum
 	SDKGRADIENTSHADER_OCTAVES		= 1008,
 	SDKGRADIENTSHADER_SCALE			= 1009,
 	SDKGRADIENTSHADER_FREQ				= 1010,
-	SDKGRADIENTSHADER_ABSOLUTE		= 1011
+	SDKGRADIENTSHADER_ABSOLUTE		= 1011,
+	SDKGRADIENTSHADER_LATTICE		= 1012,	// BOOL
+	SDKGRADIENTSHADER_LATTICE_MEMORY	= 1013	// LONG, MB
 };
 
 #endif // XSDKGRADIENT_H__
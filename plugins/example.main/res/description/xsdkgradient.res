@@ -30,5 +30,7 @@ CONTAINER Xsdkgradient
 		REAL SDKGRADIENTSHADER_SCALE		 { UNIT PERCENT; MIN 0.0; MAX 1000.0; }
 		REAL SDKGRADIENTSHADER_FREQ		 { MIN 0.0; MAX 1000.0; STEP 0.1; }
 		BOOL SDKGRADIENTSHADER_ABSOLUTE { }
+		BOOL SDKGRADIENTSHADER_LATTICE { }
+		LONG SDKGRADIENTSHADER_LATTICE_MEMORY { MIN 1; MAX 1024; }
 	}
 }
\ No newline at end of file
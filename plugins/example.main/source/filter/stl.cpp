@@ -5,7 +5,9 @@
 #include "fsdkstlimport.h"
 #include "fsdkstlexport.h"
 #include "main.h"
-#include <stdio.h>
+#include "stl_parser.h"
+#include "maxon/atomictypes.h"
+#include "maxon/parallelfor.h"
 
 using namespace cinema;
 
@@ -26,6 +28,8 @@ Bool STLLoaderData::Init(GeListNode* node, Bool isCloneInit)
 	AutoAlloc<UnitScaleData> unit;
 	if (unit)
 		data->SetData(SDKSTLIMPORTFILTER_SCALE, GeData(*unit));
+	data->SetFloat(SDKSTLIMPORTFILTER_WELD_TOLERANCE, 0.0);
+	data->SetInt32(SDKSTLIMPORTFILTER_MEMORY_LIMIT, 0);
 
 	return true;
 }
@@ -46,6 +50,7 @@ Bool STLSaverData::Init(GeListNode* node, Bool isCloneInit)
 	AutoAlloc<UnitScaleData> unit;
 	if (unit)
 		data->SetData(SDKSTLEXPORTFILTER_SCALE, GeData(*unit));
+	data->SetBool(SDKSTLEXPORTFILTER_ASCII, false);
 
 	return true;
 }
@@ -53,6 +58,19 @@ Bool STLSaverData::Init(GeListNode* node, Bool isCloneInit)
 #define ARG_MAXCHARS 256
 #define	STL_SPEEDUP	 4096
 
+// number of triangle records read from a binary file at once
+#define STL_BINARY_CHUNK	 8192
+
+// minimum size of a part of an ASCII file that is parsed by one job
+#define STL_ASCII_CHUNK		 (1 << 20)
+
+// size of the window of an ASCII file that is read at once
+#define STL_ASCII_WINDOW	 (64 << 20)
+
+// bytes at the end of the carried rest of a window that are searched for a facet again, a
+// "facet normal" whose "normal" was not read yet fits in them
+#define STL_FACET_HEAD		 64
+
 struct ZPolygon
 {
 	Vector a, b, c;
@@ -64,15 +82,15 @@ public:
 	BaseFile*			 file;
 	SCENEFILTER		 flags;
 	Char					 str[ARG_MAXCHARS], speedup[STL_SPEEDUP];
-	Int						 filepos, filelen, vbuf, vcnt;
+	Int						 filepos, filelen;
+	Int						 limit;		// memory ceiling of the import in bytes, 0 for no limit
+	Bool					 limitExceeded;
 	PolygonObject* op;
-	ZPolygon*			 vadr;
 
 	STLLOAD();
 	~STLLOAD();
 
 	Bool ReadArg();
-	Bool ReadFloat(Float& l);
 };
 
 Bool STLLOAD::ReadArg()
@@ -121,18 +139,6 @@ Bool STLLOAD::ReadArg()
 	}
 }
 
-Bool STLLOAD::ReadFloat(Float& r)
-{
-	double z;
-	if (!ReadArg() || sscanf(str, "%lf", &z) != 1)
-	{
-		file->SetError(FILEERROR::WRONG_VALUE);
-		return false;
-	}
-	r = (Float)z;
-	return true;
-}
-
 STLLOAD::STLLOAD()
 {
 	flags = SCENEFILTER::NONE;
@@ -140,17 +146,15 @@ STLLOAD::STLLOAD()
 	str[0]	= 0;
 	filepos	= 0;
 	filelen	= 0;
+	limit = 0;
+	limitExceeded = false;
 	file = BaseFile::Alloc();
-	vadr = nullptr;
-	vcnt = 0;
-	vbuf = 500;
 }
 
 STLLOAD::~STLLOAD()
 {
 	BaseFile::Free(file);
 	blDelete(op);
-	DeleteMem(vadr);
 }
 
 static void CapString(Char* s)
@@ -193,201 +197,543 @@ Bool STLLoaderData::Identify(BaseSceneLoader* node, const Filename& name, UChar*
 	return true;
 }
 
-FILEERROR STLLoaderData::Load(BaseSceneLoader* node, const Filename& name, BaseDocument* doc, SCENEFILTER flags, maxon::String* error, BaseThread* thread)
+// merges the points of the triangles while they are read, points that are not farther apart
+// than the tolerance share one index. The points are hashed into cells of the tolerance size
+// and compared with the points of their own and of the neighbouring cells. A tolerance of 0
+// merges identical points only.
+class STLWelder
 {
-	BaseContainer bc;
-	Int32					mode = 0, pnt = 0, pcnt = 0, i, cnt, index;
-	Vector				v[3], *padr = nullptr;
-	CPolygon*			vadr = nullptr;
-	STLLOAD				stl;
-	Char c;
-
-	if (!(flags & SCENEFILTER::OBJECTS))
-		return FILEERROR::NONE;
+public:
+	explicit STLWelder(Float tolerance) : _tolerance(maxon::Max(tolerance, 0.0))
+	{
+		_invCellSize = _tolerance > 0.0 ? 1.0 / _tolerance : 0.0;
+	}
 
-	if (!stl.file)
-		return FILEERROR::OUTOFMEMORY;
-	if (!stl.file->Open(name, FILEOPEN::READ, FILEDIALOG::NONE, BYTEORDER::V_INTEL))
-		return stl.file->GetError();
+	maxon::Result<void> Reserve(Int expectedPoints)
+	{
+		iferr_scope;
 
-	Float scl = 1.0;
-	const UnitScaleData* src = node->GetDataInstanceRef().GetCustomDataType<UnitScaleData>(SDKSTLIMPORTFILTER_SCALE);
-	if (src)
-		scl = CalculateTranslationScale(src, doc->GetDataInstanceRef().GetCustomDataType<UnitScaleData>(DOCUMENT_DOCUNIT));
+		_points.EnsureCapacity(expectedPoints) iferr_return;
+		_next.EnsureCapacity(expectedPoints) iferr_return;
 
-	stl.flags = flags;
-	stl.filelen = (Int)stl.file->GetLength();
+		return maxon::OK;
+	}
 
-	if (stl.ReadArg() && !LexCompare("solid", stl.str))	// ASCII mode
+	// returns the index of the point p is merged with, or NOTOK if there is none
+	Int32 Find(const Vector& p) const
 	{
-		while (stl.filepos < stl.filelen && stl.ReadArg())
-		{
-			if (thread && thread->TestBreak())
-			{
-				stl.file->SetError(FILEERROR::USERBREAK); break;
-			}
+		const Cell cell = GetCell(p);
 
-			for (index = 0; index < (Int32)strlen(stl.str); index++)
-			{
-				Char chr = stl.str[index];
-				if (chr >= 1 && chr <= 7)
-					goto Binary;
-			}
+		if (_tolerance == 0.0)
+		{
+			const Int32* last = _cells.FindValue(cell);
+			return last ? *last : NOTOK;
+		}
 
-			if (!LexCompare(stl.str, "facet"))
-			{
-				mode = 1;
-			}
-			else if (!LexCompare(stl.str, "outer") && mode == 1)
-			{
-				mode = 2;
-			}
-			else if (!LexCompare(stl.str, "loop") && mode == 2)
-			{
-				mode = 3;
-			}
-			else if (!LexCompare(stl.str, "vertex") && mode == 3 && pnt < 3)
-			{
-				stl.ReadFloat(v[pnt].x);
-				stl.ReadFloat(v[pnt].z);
-				stl.ReadFloat(v[pnt].y);
-				pnt++;
-			}
-			else if (!LexCompare(stl.str, "endloop") || !LexCompare(stl.str, "endfacet"))
+		for (Int64 dz = -1; dz <= 1; dz++)
+		{
+			for (Int64 dy = -1; dy <= 1; dy++)
 			{
-				if (pnt == 3)
+				for (Int64 dx = -1; dx <= 1; dx++)
 				{
-					if (!stl.vadr || stl.vcnt >= stl.vbuf)
+					const Int32* last = _cells.FindValue(Cell { cell.x + dx, cell.y + dy, cell.z + dz });
+					for (Int32 i = last ? *last : NOTOK; i != NOTOK; i = _next[i])
 					{
-						ZPolygon* nvadr = nullptr;
-						if (stl.vbuf > 0)
-						{
-							iferr (nvadr = NewMemClear(ZPolygon, stl.vbuf * 2))
-								return FILEERROR::OUTOFMEMORY;
-						}
-						if (!nvadr)
-							return FILEERROR::OUTOFMEMORY;
-						CopyMemType(stl.vadr, nvadr, stl.vcnt);
-						DeleteMem(stl.vadr);
-						stl.vadr	= nvadr;
-						stl.vbuf *= 2;
+						if (IsMerged(_points[i], p))
+							return i;
 					}
-
-					stl.vadr[stl.vcnt].a = v[0];
-					stl.vadr[stl.vcnt].b = v[1];
-					stl.vadr[stl.vcnt].c = v[2];
-					stl.vcnt++;
 				}
-				mode = 0;
-				pnt	 = 0;
 			}
 		}
+
+		return NOTOK;
 	}
-	else
+
+	// checks if two points are merged
+	Bool IsMerged(const Vector& a, const Vector& b) const
+	{
+		if (_tolerance == 0.0)
+			return GetCell(a) == GetCell(b);
+		return (a - b).GetSquaredLength() <= _tolerance * _tolerance;
+	}
+
+	// adds a point that is not merged with an existing one, returns its index
+	maxon::Result<Int32> Insert(const Vector& p)
+	{
+		iferr_scope;
+
+		const Cell	cell = GetCell(p);
+		const Int32 index = Int32(_points.GetCount());
+		_points.Append(p) iferr_return;
+
+		Int32* last = _cells.FindValue(cell);
+		_next.Append(last ? *last : NOTOK) iferr_return;
+		if (last)
+			*last = index;
+		else
+			_cells.Insert(cell, index) iferr_return;
+
+		return index;
+	}
+
+	const maxon::BaseArray<Vector>& GetPoints() const { return _points; }
+
+	// estimated memory of the points and of the hash
+	Int GetMemory() const
+	{
+		return _points.GetCapacityCount() * SIZEOF(Vector) + _next.GetCapacityCount() * SIZEOF(Int32) + _cells.GetCount() * (SIZEOF(Cell) + SIZEOF(Int32) + 2 * SIZEOF(void*));
+	}
+
+	void Reset()
 	{
+		_cells.Reset();
+		_points.Reset();
+		_next.Reset();
+	}
+
+private:
+	struct Cell
+	{
+		Int64 x, y, z;
+
+		Bool operator ==(const Cell& c) const { return x == c.x && y == c.y && z == c.z; }
+		maxon::HashInt GetHashCode() const { return maxon::HashInt(UInt64(x) * 73856093 ^ UInt64(y) * 19349663 ^ UInt64(z) * 83492791); }
+	};
 
-	Binary:
-		stl.file->Seek(80, FILESEEK::START);
-		Int32 val;
-		if (!stl.file->ReadInt32(&val) || val <= 0)
+	Cell GetCell(const Vector& p) const
+	{
+		if (_tolerance > 0.0)
+			return Cell { (Int64)Floor(p.x * _invCellSize), (Int64)Floor(p.y * _invCellSize), (Int64)Floor(p.z * _invCellSize) };
+
+		// the bits of the coordinates, -0.0 and 0.0 are the same point
+		Cell				 cell;
+		const Vector q = p + Vector(0.0);
+		CopyMem(&q.x, &cell.x, sizeof(cell.x));
+		CopyMem(&q.y, &cell.y, sizeof(cell.y));
+		CopyMem(&q.z, &cell.z, sizeof(cell.z));
+		return cell;
+	}
+
+	maxon::HashMap<Cell, Int32> _cells;	// last point of a cell
+	maxon::BaseArray<Vector>		_points;
+	maxon::BaseArray<Int32>			_next;	// previous point of the same cell
+	const Float									_tolerance;
+	Float												_invCellSize;
+};
+
+// adds a triangle with welded points, triangles that collapsed are dropped. The points are
+// looked up first and only the new points of a kept triangle are added, so that a dropped
+// triangle leaves no unreferenced points behind.
+static maxon::Result<void> AddTriangle(STLWelder& welder, maxon::BaseArray<CPolygon>& polys, const Vector& a, const Vector& b, const Vector& c)
+{
+	iferr_scope;
+
+	const Vector* p[3] = { &a, &b, &c };
+	Int32					index[3];
+
+	for (Int32 k = 0; k < 3; k++)
+	{
+		index[k] = welder.Find(*p[k]);
+
+		// a new point gets the negative index -2 - k, unless it is merged with a new point of the triangle
+		for (Int32 j = 0; j < k && index[k] == NOTOK; j++)
+		{
+			if (index[j] < NOTOK && welder.IsMerged(*p[j], *p[k]))
+				index[k] = index[j];
+		}
+		if (index[k] == NOTOK)
+			index[k] = -2 - k;
+	}
+
+	if (index[0] == index[1] || index[1] == index[2] || index[2] == index[0])
+		return maxon::OK;
+
+	for (Int32 k = 0; k < 3; k++)
+	{
+		if (index[k] < 0)
+			index[k] = welder.Insert(*p[k]) iferr_return;
+	}
+
+	polys.Append(CPolygon(index[0], index[2], index[1])) iferr_return;
+
+	return maxon::OK;
+}
+
+// checks the memory of the welded mesh and of the scratch data of the loader against the ceiling
+static Bool ExceedsLimit(STLLOAD& stl, const STLWelder& welder, const maxon::BaseArray<CPolygon>& polys, Int scratch)
+{
+	if (stl.limit > 0 && welder.GetMemory() + polys.GetCapacityCount() * SIZEOF(CPolygon) + scratch > stl.limit)
+		stl.limitExceeded = true;
+	return stl.limitExceeded;
+}
+
+// decodes a float of a binary record, the file and all supported platforms are little endian
+static inline Float ReadRecordFloat(const UChar* p)
+{
+	Float32 v;
+	CopyMem(p, &v, sizeof(v));
+	return (Float)v;
+}
+
+// reads the triangles of a binary file in blocks of records and welds their points,
+// the header and the triangle count are checked up front
+static FILEERROR LoadBinary(STLLOAD& stl, Float scl, STLWelder& welder, maxon::BaseArray<CPolygon>& polys, BaseThread* thread)
+{
+	Int32 count;
+	if (!stl.file->Seek(STL_BINARY_HEADER, FILESEEK::START) || !stl.file->ReadInt32(&count) || count <= 0)
+		return FILEERROR::WRONG_VALUE;
+
+	// the file has to hold all records, every triangle gets 3 points
+	if (Int64(count) * STL_BINARY_RECORD > Int64(stl.filelen) - (STL_BINARY_HEADER + 4) || Int64(count) * 3 > maxon::LIMIT<Int32>::MAX)
+		return FILEERROR::WRONG_VALUE;
+
+	maxon::BaseArray<UChar> records;
+	iferr (records.Resize(Int(maxon::Min(count, Int32(STL_BINARY_CHUNK))) * STL_BINARY_RECORD))
+		return FILEERROR::OUTOFMEMORY;
+
+	// with a memory ceiling the arrays grow with the welded mesh
+	if (stl.limit == 0)
+	{
+		iferr (welder.Reserve(Int(count) / 2))
+			return FILEERROR::OUTOFMEMORY;
+		iferr (polys.EnsureCapacity(count))
+			return FILEERROR::OUTOFMEMORY;
+	}
+
+	for (Int32 first = 0; first < count; first += STL_BINARY_CHUNK)
+	{
+		if (thread && thread->TestBreak())
+			return FILEERROR::USERBREAK;
+
+		const Int32 chunk = maxon::Min(count - first, Int32(STL_BINARY_CHUNK));
+		const Int		bytes = Int(chunk) * STL_BINARY_RECORD;
+		if (stl.file->ReadBytes(records.GetFirst(), bytes, true) != bytes)
 			return FILEERROR::WRONG_VALUE;
-		stl.vbuf = val;
 
-		if (stl.vbuf > 0)
+		const UChar* rec = records.GetFirst();
+		for (Int32 i = 0; i < chunk; i++, rec += STL_BINARY_RECORD)
 		{
-			iferr (stl.vadr = NewMemClear(ZPolygon, stl.vbuf))
+			// the normal is skipped, it is recalculated from the points
+			const UChar* p = rec + 12;
+			if (rec[48] != 0 || rec[49] != 0)
+				return FILEERROR::WRONG_VALUE;
+
+			const Vector a = Vector(ReadRecordFloat(p), ReadRecordFloat(p + 8), ReadRecordFloat(p + 4)) * scl;
+			const Vector b = Vector(ReadRecordFloat(p + 12), ReadRecordFloat(p + 20), ReadRecordFloat(p + 16)) * scl;
+			const Vector c = Vector(ReadRecordFloat(p + 24), ReadRecordFloat(p + 32), ReadRecordFloat(p + 28)) * scl;
+			iferr (AddTriangle(welder, polys, a, b, c))
 				return FILEERROR::OUTOFMEMORY;
 		}
-		else
+
+		if (ExceedsLimit(stl, welder, polys, records.GetCapacityCount()))
+			return FILEERROR::OUTOFMEMORY;
+
+		if (stl.flags & SCENEFILTER::PROGRESSALLOWED)
+			StatusSetBar(Int32(Float(first + chunk) / Float(count) * 100.0));
+	}
+
+	return FILEERROR::NONE;
+}
+
+// a part of an ASCII file that starts at a facet, and its triangles
+struct STLAsciiChunk
+{
+	const Char*									begin = nullptr;
+	const Char*									end = nullptr;
+	maxon::BaseArray<ZPolygon>	polys;
+	FILEERROR										error = FILEERROR::NONE;
+	Bool												binary = false;
+};
+
+// parses the triangles of a chunk, the states match the facet / outer loop / vertex structure
+static void ParseAsciiChunk(STLAsciiChunk& chunk, BaseThread* thread)
+{
+	const Char* pos = chunk.begin;
+	const Char* token;
+	Int					len;
+	Int32				mode = 0, pnt = 0, tokens = 0;
+	Vector			v[3];
+
+	while (NextToken(pos, chunk.end, token, len, chunk.binary))
+	{
+		if (!(++tokens & 0xffff) && thread && thread->TestBreak())
+		{
+			chunk.error = FILEERROR::USERBREAK;
+			return;
+		}
+
+		if (IsKeyword(token, len, "FACET"))
 		{
-			stl.vadr = nullptr;
+			mode = 1;
 		}
-		if (!stl.vadr)
+		else if (IsKeyword(token, len, "OUTER") && mode == 1)
+		{
+			mode = 2;
+		}
+		else if (IsKeyword(token, len, "LOOP") && mode == 2)
+		{
+			mode = 3;
+		}
+		else if (IsKeyword(token, len, "VERTEX") && mode == 3 && pnt < 3)
+		{
+			// y and z are swapped
+			Float* coords[3] = { &v[pnt].x, &v[pnt].z, &v[pnt].y };
+			for (Float* c : coords)
+			{
+				if (!NextToken(pos, chunk.end, token, len, chunk.binary) || !ParseFloat(token, token + len, *c))
+				{
+					if (!chunk.binary)
+						chunk.error = FILEERROR::WRONG_VALUE;
+					return;
+				}
+			}
+			pnt++;
+		}
+		else if (IsKeyword(token, len, "ENDLOOP") || IsKeyword(token, len, "ENDFACET"))
+		{
+			if (pnt == 3)
+			{
+				ZPolygon poly;
+				poly.a = v[0];
+				poly.b = v[1];
+				poly.c = v[2];
+				iferr (chunk.polys.Append(poly))
+				{
+					chunk.error = FILEERROR::OUTOFMEMORY;
+					return;
+				}
+			}
+			mode = 0;
+			pnt	 = 0;
+		}
+	}
+}
+
+// reads an ASCII file in windows that end before a facet. The windows are split at facets into
+// chunks that are parsed concurrently, their triangles are welded in file order. Only the window
+// and the welded mesh are kept in memory. binary is set if the file turns out to be a binary file
+// whose header starts with "solid" but whose size doesn't match its triangle count.
+static FILEERROR LoadAscii(STLLOAD& stl, Float scl, STLWelder& welder, maxon::BaseArray<CPolygon>& polys, BaseThread* thread, Bool& binary)
+{
+	const Int windowSize = stl.limit > 0 ? maxon::Max(Int(STL_ASCII_CHUNK), maxon::Min(Int(STL_ASCII_WINDOW), stl.limit / 4)) : Int(STL_ASCII_WINDOW);
+
+	maxon::BaseArray<Char>					window;
+	maxon::BaseArray<STLAsciiChunk> chunks;
+	const Int												maxChunks = maxon::ThreadRef::GetCurrentThreadCount() * 4;
+	iferr (chunks.Resize(maxChunks))
+		return FILEERROR::OUTOFMEMORY;
+
+	if (!stl.file->Seek(0, FILESEEK::START))
+		return FILEERROR::READ;
+
+	Int filepos = 0, carry = 0;
+	while (filepos < stl.filelen)
+	{
+		if (thread && thread->TestBreak())
+			return FILEERROR::USERBREAK;
+
+		// the window starts with the rest of the last one
+		const Int bytes = maxon::Min(windowSize, stl.filelen - filepos);
+		iferr (window.Resize(carry + bytes))
 			return FILEERROR::OUTOFMEMORY;
+		if (ExceedsLimit(stl, welder, polys, window.GetCapacityCount()))
+			return FILEERROR::OUTOFMEMORY;
+		if (stl.file->ReadBytes(window.GetFirst() + carry, bytes, true) != bytes)
+			return FILEERROR::READ;
+		filepos += bytes;
+
+		const Char* begin = window.GetFirst();
+		const Char* end = begin + window.GetCount();
+
+		// the carried rest was searched already, only its end may hold a facet whose "normal"
+		// is read now. A facet that is missed only moves the cut to a later facet.
+		const Char* cut = filepos < stl.filelen ? FindLastFacet(begin + maxon::Max(Int(0), carry - STL_FACET_HEAD), end) : end;
 
-		for (cnt = 0; cnt < stl.vbuf; cnt++)
+		// without a facet after its start the whole window is carried on and the next one is
+		// appended, a file without any facet in its first window is tried as a binary file
+		if (cut == end && filepos < stl.filelen)
 		{
-			if (thread && thread->TestBreak())
+			if (filepos == bytes && FindFacet(begin, begin, end) == end)
 			{
-				stl.file->SetError(FILEERROR::USERBREAK); break;
+				binary = true;
+				return FILEERROR::NONE;
 			}
+			carry = window.GetCount();
+			continue;
+		}
 
-			if (stl.file->GetPosition() >= stl.filelen)
-				return FILEERROR::WRONG_VALUE;
+		const Int size = cut - begin;
+		const Int chunkCount = maxon::Max(Int(1), maxon::Min(size / STL_ASCII_CHUNK, maxChunks));
 
-			stl.file->Seek(12);
-
-			Float32 tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].a.x = tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].a.z = tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].a.y = tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].b.x = tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].b.z = tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].b.y = tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].c.x = tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].c.z = tmp;
-			stl.file->ReadFloat32(&tmp); stl.vadr[stl.vcnt].c.y = tmp;
-			stl.file->ReadChar(&c);
-			if (c != 0)
-				return FILEERROR::WRONG_VALUE;
-			stl.file->ReadChar(&c);
-			if (c != 0)
-				return FILEERROR::WRONG_VALUE;
-			stl.vcnt++;
+		const Char* pos = begin;
+		for (Int i = 0; i < chunkCount; i++)
+		{
+			chunks[i].begin = pos;
+			pos = i + 1 < chunkCount ? FindFacet(maxon::Max(pos, begin + size * (i + 1) / chunkCount), begin, cut) : cut;
+			chunks[i].end = pos;
+		}
 
-			if (!(cnt & 63) && flags & SCENEFILTER::PROGRESSALLOWED)
-				StatusSetBar(Int32(Float(cnt) / Float(stl.vbuf) * 100.0));
+		maxon::ParallelFor::Dynamic(0, chunkCount,
+			[&chunks, thread](Int i)
+			{
+				ParseAsciiChunk(chunks[i], thread);
+			});
+
+		// the chunks are stitched in file order, the points are welded on the way
+		Int scratch = window.GetCapacityCount();
+		for (Int i = 0; i < chunkCount; i++)
+		{
+			STLAsciiChunk& chunk = chunks[i];
+			if (chunk.binary)
+			{
+				binary = true;
+				return FILEERROR::NONE;
+			}
+			if (chunk.error != FILEERROR::NONE)
+				return chunk.error;
+
+			for (const ZPolygon& z : chunk.polys)
+			{
+				iferr (AddTriangle(welder, polys, z.a * scl, z.b * scl, z.c * scl))
+					return FILEERROR::OUTOFMEMORY;
+			}
+
+			scratch += chunk.polys.GetCapacityCount() * SIZEOF(ZPolygon);
+			chunk.polys.Flush();
 		}
+
+		if (welder.GetPoints().GetCount() > maxon::LIMIT<Int32>::MAX || polys.GetCount() > maxon::LIMIT<Int32>::MAX)
+			return FILEERROR::OUTOFMEMORY;
+		if (ExceedsLimit(stl, welder, polys, scratch))
+			return FILEERROR::OUTOFMEMORY;
+
+		// the rest of the window starts the next one
+		carry = end - cut;
+		memmove(window.GetFirst(), cut, carry);
+
+		if (stl.flags & SCENEFILTER::PROGRESSALLOWED)
+			StatusSetBar(Int32(Float(filepos) / Float(stl.filelen) * 100.0));
 	}
 
-	Filename nn = name;
-	nn.ClearSuffix();
-	stl.op = PolygonObject::Alloc(Int32(stl.vcnt * 3), (Int32)stl.vcnt);
-	if (!stl.op)
+	return FILEERROR::NONE;
+}
+
+FILEERROR STLLoaderData::Load(BaseSceneLoader* node, const Filename& name, BaseDocument* doc, SCENEFILTER flags, maxon::String* error, BaseThread* thread)
+{
+	STLLOAD stl;
+
+	if (!(flags & SCENEFILTER::OBJECTS))
+		return FILEERROR::NONE;
+
+	if (!stl.file)
 		return FILEERROR::OUTOFMEMORY;
-	stl.op->SetName(nn.GetFileString());
+	if (!stl.file->Open(name, FILEOPEN::READ, FILEDIALOG::NONE, BYTEORDER::V_INTEL))
+		return stl.file->GetError();
 
-	padr = stl.op->GetPointW();
-	vadr = stl.op->GetPolygonW();
+	Float scl = 1.0;
+	const UnitScaleData* src = node->GetDataInstanceRef().GetCustomDataType<UnitScaleData>(SDKSTLIMPORTFILTER_SCALE);
+	if (src)
+		scl = CalculateTranslationScale(src, doc->GetDataInstanceRef().GetCustomDataType<UnitScaleData>(DOCUMENT_DOCUNIT));
+
+	stl.flags = flags;
+	stl.filelen = (Int)stl.file->GetLength();
 
-	for (i = 0; i < stl.vcnt; i++)
+	stl.limit = Int(node->GetDataInstanceRef().GetInt32(SDKSTLIMPORTFILTER_MEMORY_LIMIT)) << 20;
+
+	STLWelder									welder(node->GetDataInstanceRef().GetFloat(SDKSTLIMPORTFILTER_WELD_TOLERANCE));
+	maxon::BaseArray<CPolygon> polys;
+
+	// binary files whose header starts with "solid" are detected by their size, the ASCII
+	// parser falls back to the binary loader if a file with a wrong size turns out to be binary
+	Int32 count = 0;
+	Bool	binary = stl.filelen > STL_BINARY_HEADER + 4 && stl.file->Seek(STL_BINARY_HEADER, FILESEEK::START) && stl.file->ReadInt32(&count) && IsBinarySize(count, stl.filelen);
+	if (!binary)
 	{
-		vadr[i] = CPolygon(pcnt, pcnt + 2, pcnt + 1);
-		padr[pcnt++] = stl.vadr[i].a;
-		padr[pcnt++] = stl.vadr[i].b;
-		padr[pcnt++] = stl.vadr[i].c;
+		if (!stl.file->Seek(0, FILESEEK::START))
+			return FILEERROR::READ;
+		binary = !(stl.ReadArg() && !LexCompare("solid", stl.str));
 	}
 
-	pcnt = stl.op->GetPointCount();
-	for (i = 0; i < pcnt; i++)
-		padr[i] *= scl;
+	FILEERROR res = FILEERROR::NONE;
 
-	stl.op->Message(MSG_UPDATE);
-	doc->InsertObject(stl.op, nullptr, nullptr);
+	if (!binary)
+		res = LoadAscii(stl, scl, welder, polys, thread, binary);
+	if (res == FILEERROR::NONE && binary)
+	{
+		welder.Reset();
+		polys.Reset();
+		res = LoadBinary(stl, scl, welder, polys, thread);
+	}
+
+	// the object is a copy of the welded mesh
+	const maxon::BaseArray<Vector>& points = welder.GetPoints();
+	if (res == FILEERROR::NONE && ExceedsLimit(stl, welder, polys, points.GetCount() * SIZEOF(Vector) + polys.GetCount() * SIZEOF(CPolygon)))
+		res = FILEERROR::OUTOFMEMORY;
 
-	ModelingCommandData mdat;
-	mdat.doc = doc;
-	mdat.op	 = stl.op;
-	mdat.bc	 = &bc;
+	if (res != FILEERROR::NONE)
+	{
+		if (stl.limitExceeded && error)
+			*error = FormatString("The mesh needs more than the memory limit of @ MB.", stl.limit >> 20);
+		stl.file->SetError(res);
+		return res;
+	}
+
+	// the object gets the welded points, no optimize pass is needed
+	stl.op = PolygonObject::Alloc(Int32(points.GetCount()), Int32(polys.GetCount()));
+	if (!stl.op)
+		return FILEERROR::OUTOFMEMORY;
+
+	CopyMemType(points.GetFirst(), stl.op->GetPointW(), points.GetCount());
+	CopyMemType(polys.GetFirst(), stl.op->GetPolygonW(), polys.GetCount());
+
+	// every corner of a triangle is either a new point or a merged one
+	ApplicationOutput("STL import of @: @ points merged, @ points and @ triangles created", name.GetFileString(), polys.GetCount() * 3 - points.GetCount(), points.GetCount(), polys.GetCount());
+
+	Filename nn = name;
+	nn.ClearSuffix();
+	stl.op->SetName(nn.GetFileString());
 
-	bc.SetBool(MDATA_OPTIMIZE_POINTS, true);
-	bc.SetBool(MDATA_OPTIMIZE_POLYGONS, true);
-	bc.SetFloat(MDATA_OPTIMIZE_TOLERANCE, 0.0);
-	if (stl.file->GetError() != FILEERROR::NONE || !SendModelingCommand(MCOMMAND_OPTIMIZE, mdat))
-		blDelete(stl.op);
+	stl.op->Message(MSG_UPDATE);
+	doc->InsertObject(stl.op, nullptr, nullptr);
 
 	stl.op = nullptr;	// detach object from structure
 
 	return stl.file->GetError();
 }
 
+// number of polygons of an object that are serialized by one job
+#define STL_EXPORT_JOB_POLYGONS 8192
+
+// memory of the buffers of the jobs that are serialized at once, a single job always fits
+#define STL_EXPORT_BATCH_MEMORY (64 << 20)
+
+// upper bound of the size of a facet of an ASCII file, 12 numbers and the keywords
+#define STL_ASCII_FACET_SIZE		(12 * STL_FLOAT_SIZE + 104)
+
+// a polygon object of the polygonized document and its global matrix
+struct STLExportObject
+{
+	const PolygonObject* op;
+	Matrix							 mg;
+};
+
+// a range of polygons of an object and the number of its triangles, serialized into its own buffer
+struct STLExportJob
+{
+	Int32 object, first, count, triangles;
+};
+
 class STLSAVE
 {
 public:
 	BaseFile*			file;
 	BaseDocument* doc;
-	Int32					pos, cnt;
+	Int32					cnt;
 	SCENEFILTER		flags;
+	Bool					ascii;
+
+	maxon::BaseArray<STLExportObject> objects;
+	maxon::BaseArray<STLExportJob>		jobs;
 
 	STLSAVE();
 	~STLSAVE();
@@ -397,9 +743,9 @@ public:
 STLSAVE::STLSAVE()
 {
 	doc	= nullptr;
-	pos	= 0;
 	cnt	= 0;
 	flags = SCENEFILTER::NONE;
+	ascii = false;
 	file	= BaseFile::Alloc();
 }
 
@@ -409,64 +755,126 @@ STLSAVE::~STLSAVE()
 	BaseDocument::Free(doc);
 }
 
-static void CountPolygons(STLSAVE& stl, BaseObject* op)
+// collects the polygon objects, splits them into jobs and counts the triangles
+static maxon::Result<void> CollectObjects(STLSAVE& stl, BaseObject* op, const Matrix& up)
 {
-	while (op)
+	iferr_scope;
+
+	for (; op; op = op->GetNext())
 	{
+		const Matrix mg = up * op->GetMl();
 		if (op->GetType() == Opolygon)
 		{
-			const CPolygon* vadr = ToPoly(op)->GetPolygonR();
-			Int32 i, vcnt = ToPoly(op)->GetPolygonCount();
+			const PolygonObject* poly = ToPoly(op);
+			const CPolygon*			 vadr = poly->GetPolygonR();
+			const Int32					 vcnt = poly->GetPolygonCount();
+
+			const Int32 object = Int32(stl.objects.GetCount());
+			stl.objects.Append(STLExportObject { poly, mg }) iferr_return;
+
+			for (Int32 first = 0; first < vcnt; first += STL_EXPORT_JOB_POLYGONS)
+			{
+				STLExportJob job { object, first, maxon::Min(vcnt - first, Int32(STL_EXPORT_JOB_POLYGONS)), 0 };
+
+				// quadrangles are written as two triangles
+				for (Int32 i = first; i < first + job.count; i++)
+					job.triangles += vadr[i].c != vadr[i].d ? 2 : 1;
 
-			stl.cnt += vcnt;
-			for (i = 0; i < vcnt; i++)
-				if (vadr[i].c != vadr[i].d)
-					stl.cnt++;
+				stl.cnt += job.triangles;
+				stl.jobs.Append(job) iferr_return;
+			}
 		}
-		CountPolygons(stl, op->GetDown());
-		op = op->GetNext();
+		CollectObjects(stl, op->GetDown(), mg) iferr_return;
 	}
+
+	return maxon::OK;
 }
 
-static void WritePolygon(STLSAVE& stl, const Vector& pa, const Vector& pb, const Vector& pc)
+static inline Char* WriteRecordVector(Char* dst, const Vector& v)
 {
-	Vector n = !Cross(pb - pa, pc - pa);
+	// y and z are swapped, the file is little endian like all supported platforms
+	const Float32 f[3] = { (Float32)v.x, (Float32)v.z, (Float32)v.y };
+	CopyMem(f, dst, sizeof(f));
+	return dst + sizeof(f);
+}
 
-	stl.file->WriteFloat32((Float32)n.x); stl.file->WriteFloat32((Float32)n.z);	stl.file->WriteFloat32((Float32)n.y);
-	stl.file->WriteFloat32((Float32)pa.x); stl.file->WriteFloat32((Float32)pa.z);	stl.file->WriteFloat32((Float32)pa.y);
-	stl.file->WriteFloat32((Float32)pc.x); stl.file->WriteFloat32((Float32)pc.z);	stl.file->WriteFloat32((Float32)pc.y);
-	stl.file->WriteFloat32((Float32)pb.x); stl.file->WriteFloat32((Float32)pb.z);	stl.file->WriteFloat32((Float32)pb.y);
-	stl.file->WriteChar(0);
-	stl.file->WriteChar(0);
+// copies a keyword without its terminating zero
+template <Int N> static inline Char* WriteText(Char* dst, const Char (&text)[N])
+{
+	CopyMem(text, dst, N - 1);
+	return dst + N - 1;
+}
 
-	stl.pos++;
-	if (!(stl.pos & 63) && Bool(stl.flags & SCENEFILTER::PROGRESSALLOWED))
-		StatusSetBar(Int32(Float(stl.pos) / Float(stl.cnt) * 100.0));
+static inline Char* WriteTextVector(Char* dst, const Vector& v)
+{
+	// y and z are swapped, the numbers are written without the locale like the parser reads them
+	dst = WriteFloat(dst, (Float32)v.x);
+	*dst++ = ' ';
+	dst = WriteFloat(dst, (Float32)v.z);
+	*dst++ = ' ';
+	dst = WriteFloat(dst, (Float32)v.y);
+	*dst++ = '\n';
+	return dst;
 }
 
-static void WriteObjects(STLSAVE& stl, BaseObject* op, Matrix up)
+static Char* WriteTriangle(Bool ascii, Char* dst, const Vector& pa, const Vector& pb, const Vector& pc)
 {
-	Matrix mg;
-	while (op)
+	const Vector n = !Cross(pb - pa, pc - pa);
+
+	if (!ascii)
 	{
-		mg = up * op->GetMl();
-		if (op->GetType() == Opolygon)
-		{
-			const Vector*		padr = ToPoly(op)->GetPointR();
-			const CPolygon* vadr = ToPoly(op)->GetPolygonR();
-			Int32 i, vcnt = ToPoly(op)->GetPolygonCount();
+		dst = WriteRecordVector(dst, n);
+		dst = WriteRecordVector(dst, pa);
+		dst = WriteRecordVector(dst, pc);
+		dst = WriteRecordVector(dst, pb);
+		*dst++ = 0;
+		*dst++ = 0;
+		return dst;
+	}
 
-			for (i = 0; i < vcnt; i++)
-			{
-				WritePolygon(stl, mg * padr[vadr[i].a], mg * padr[vadr[i].b], mg * padr[vadr[i].c]);
+	dst = WriteText(dst, "  facet normal ");
+	dst = WriteTextVector(dst, n);
+	dst = WriteText(dst, "    outer loop\n");
+	for (const Vector* p : { &pa, &pc, &pb })
+	{
+		dst = WriteText(dst, "      vertex ");
+		dst = WriteTextVector(dst, *p);
+	}
+	dst = WriteText(dst, "    endloop\n  endfacet\n");
 
-				if (vadr[i].c != vadr[i].d)
-					WritePolygon(stl, mg * padr[vadr[i].a], mg * padr[vadr[i].c], mg * padr[vadr[i].d]);
-			}
-		}
-		WriteObjects(stl, op->GetDown(), mg);
-		op = op->GetNext();
+	return dst;
+}
+
+// size of the serialized triangles of a job
+static Int GetJobSize(const STLSAVE& stl, const STLExportJob& job)
+{
+	return Int(job.triangles) * (stl.ascii ? STL_ASCII_FACET_SIZE : STL_BINARY_RECORD);
+}
+
+// serializes the triangles of a job, returns the number of bytes
+static maxon::Result<Int> SerializeJob(const STLSAVE& stl, const STLExportJob& job, maxon::BaseArray<Char>& buffer)
+{
+	iferr_scope;
+
+	const STLExportObject& obj	= stl.objects[job.object];
+	const Vector*					 padr = obj.op->GetPointR();
+	const CPolygon*				 vadr = obj.op->GetPolygonR() + job.first;
+
+	// the buffer is reused by the next batch but doesn't keep more memory than the job needs
+	buffer.Resize(GetJobSize(stl, job), maxon::COLLECTION_RESIZE_FLAGS::FIT_TO_SIZE | maxon::COLLECTION_RESIZE_FLAGS::POD_UNINITIALIZED) iferr_return;
+
+	Char* dst = buffer.GetFirst();
+	for (Int32 i = 0; i < job.count; i++)
+	{
+		const CPolygon& v = vadr[i];
+		const Vector		a = obj.mg * padr[v.a], c = obj.mg * padr[v.c];
+
+		dst = WriteTriangle(stl.ascii, dst, a, obj.mg * padr[v.b], c);
+		if (v.c != v.d)
+			dst = WriteTriangle(stl.ascii, dst, a, c, obj.mg * padr[v.d]);
 	}
+
+	return dst - buffer.GetFirst();
 }
 
 FILEERROR STLSaverData::Save(BaseSceneSaver* node, const Filename& name, BaseDocument* doc, SCENEFILTER flags)
@@ -482,22 +890,88 @@ FILEERROR STLSaverData::Save(BaseSceneSaver* node, const Filename& name, BaseDoc
 	scl = CalculateTranslationScale(doc->GetDataInstanceRef().GetCustomDataType<UnitScaleData>(DOCUMENT_DOCUNIT), scale);
 
 	stl.flags = flags;
+	stl.ascii = node->GetDataInstanceRef().GetBool(SDKSTLEXPORTFILTER_ASCII);
 	stl.doc = doc->Polygonize();
 
 	if (!stl.doc || !stl.file)
 		return FILEERROR::OUTOFMEMORY;
 
-	CountPolygons(stl, stl.doc->GetFirstObject());
+	iferr (CollectObjects(stl, stl.doc->GetFirstObject(), MatrixScale(Vector(scl))))
+		return FILEERROR::OUTOFMEMORY;
 
 	if (!stl.file->Open(name, FILEOPEN::WRITE, FILEDIALOG::NONE, BYTEORDER::V_INTEL))
 		return stl.file->GetError();
 
+	const maxon::TimeValue start = maxon::TimeValue::GetTime();
+
 	ClearMem(header, sizeof(header));
 	name.GetFileString().GetCString(header, 78, STRINGENCODING::BIT7);
-	stl.file->WriteBytes(header, 80);
-	stl.file->WriteInt32(stl.cnt);
+	if (stl.ascii)
+	{
+		stl.file->WriteBytes("solid ", 6);
+		stl.file->WriteBytes(header, strlen(header));
+		stl.file->WriteBytes("\n", 1);
+	}
+	else
+	{
+		stl.file->WriteBytes(header, 80);
+		stl.file->WriteInt32(stl.cnt);
+	}
+
+	// the jobs of a batch are serialized concurrently and written in order
+	const Int												 batchSize = maxon::ThreadRef::GetCurrentThreadCount() * 2;
+	maxon::BaseArray<maxon::BaseArray<Char>> buffers;
+	maxon::BaseArray<Int>										 sizes;
+	iferr (buffers.Resize(batchSize))
+		return FILEERROR::OUTOFMEMORY;
+	iferr (sizes.Resize(batchSize))
+		return FILEERROR::OUTOFMEMORY;
+
+	for (Int first = 0, count = 0; first < stl.jobs.GetCount() && stl.file->GetError() == FILEERROR::NONE; first += count)
+	{
+		// the batch is limited by the number of buffers and by their memory
+		Int memory = 0;
+		for (count = 0; count < batchSize && first + count < stl.jobs.GetCount(); count++)
+		{
+			const Int size = GetJobSize(stl, stl.jobs[first + count]);
+			if (count > 0 && memory + size > STL_EXPORT_BATCH_MEMORY)
+				break;
+			memory += size;
+		}
+
+		// buffers that are not used by the batch are freed
+		for (Int i = count; i < batchSize; i++)
+			buffers[i].Reset();
+
+		maxon::AtomicBool failed;
+
+		maxon::ParallelFor::Dynamic(0, count,
+			[&stl, &buffers, &sizes, &failed, first](Int i)
+			{
+				iferr (sizes[i] = SerializeJob(stl, stl.jobs[first + i], buffers[i]))
+					failed.Set(true);
+			});
+
+		if (failed.Get())
+			return FILEERROR::OUTOFMEMORY;
+
+		for (Int i = 0; i < count; i++)
+			stl.file->WriteBytes(buffers[i].GetFirst(), sizes[i]);
+
+		if (stl.flags & SCENEFILTER::PROGRESSALLOWED)
+			StatusSetBar(Int32(Float(first + count) / Float(stl.jobs.GetCount()) * 100.0));
+	}
+
+	if (stl.ascii)
+	{
+		stl.file->WriteBytes("endsolid ", 9);
+		stl.file->WriteBytes(header, strlen(header));
+		stl.file->WriteBytes("\n", 1);
+	}
 
-	WriteObjects(stl, stl.doc->GetFirstObject(), MatrixScale(Vector(scl)));
+	const Float seconds = (maxon::TimeValue::GetTime() - start).GetSeconds();
+	const Float megabytes = Float(stl.file->GetPosition()) / (1024.0 * 1024.0);
+	ApplicationOutput("STL export of @: @ triangles, @ MB in @ s, @ MB/s", name.GetFileString(), stl.cnt, megabytes, seconds, seconds > 0.0 ? megabytes / seconds : 0.0);
 
 	return stl.file->GetError();
 }
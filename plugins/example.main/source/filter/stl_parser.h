@@ -0,0 +1,289 @@
+#ifndef STL_PARSER_H__
+#define STL_PARSER_H__
+
+#include "c4d.h"
+
+// size of the header, the triangle count and a triangle record of a binary file
+#define STL_BINARY_HEADER	 80
+#define STL_BINARY_RECORD	 50
+
+//----------------------------------------------------------------------------------------
+/// Checks if a file has exactly the size of a binary file with its triangle count.
+/// This detects binary files whose header starts with "solid" like an ASCII file.
+/// @param[in] count							The triangle count after the header of the file.
+/// @param[in] filelen						The size of the file.
+/// @return												True if the file is a binary file.
+//----------------------------------------------------------------------------------------
+inline cinema::Bool IsBinarySize(cinema::Int32 count, cinema::Int filelen)
+{
+	return count > 0 && cinema::Int64(filelen) == STL_BINARY_HEADER + 4 + cinema::Int64(count) * STL_BINARY_RECORD;
+}
+
+//----------------------------------------------------------------------------------------
+/// Checks if a character separates the tokens of an ASCII STL file.
+/// @param[in] c									The character.
+/// @return												True for a space, a tab or a line break.
+//----------------------------------------------------------------------------------------
+inline cinema::Bool IsSeparator(cinema::Char c)
+{
+	return c == 10 || c == 13 || c == ' ' || c == 9;
+}
+
+//----------------------------------------------------------------------------------------
+/// Case insensitive comparison of a token with a keyword.
+/// @param[in] token							The token, doesn't need to be terminated.
+/// @param[in] len								Length of the token.
+/// @param[in] keyword						The keyword in capitals.
+/// @return												True if the token is the keyword.
+//----------------------------------------------------------------------------------------
+inline cinema::Bool IsKeyword(const cinema::Char* token, cinema::Int len, const cinema::Char* keyword)
+{
+	for (cinema::Int i = 0; i < len; i++)
+	{
+		cinema::Char c = token[i];
+		if (c >= 'a' && c <= 'z')
+			c -= 32;
+		if (c != keyword[i])
+			return false;
+	}
+	return keyword[len] == 0;
+}
+
+//----------------------------------------------------------------------------------------
+/// Finds the next token of an ASCII STL file.
+/// @param[in,out] pos						Start of the search, is set behind the token.
+/// @param[in] end								End of the text.
+/// @param[out] token							Start of the token.
+/// @param[out] len								Length of the token.
+/// @param[out] binary						Set if the token has characters of a binary file.
+/// @return												False at the end of the text or for a binary file.
+//----------------------------------------------------------------------------------------
+inline cinema::Bool NextToken(const cinema::Char*& pos, const cinema::Char* end, const cinema::Char*& token, cinema::Int& len, cinema::Bool& binary)
+{
+	while (pos < end && IsSeparator(*pos))
+		pos++;
+
+	token = pos;
+	while (pos < end && !IsSeparator(*pos))
+	{
+		if (*pos >= 1 && *pos <= 7)
+		{
+			binary = true;
+			return false;
+		}
+		pos++;
+	}
+
+	len = pos - token;
+	return len > 0;
+}
+
+//----------------------------------------------------------------------------------------
+/// Locale independent parser for the decimal numbers of an ASCII STL file.
+/// Up to 18 significant digits are kept, further digits only change the exponent.
+/// @param[in] s									Start of the number.
+/// @param[in] end								End of the number, the whole range has to be a number.
+/// @param[out] r									The value.
+/// @return												False if the range is not a number.
+//----------------------------------------------------------------------------------------
+inline cinema::Bool ParseFloat(const cinema::Char* s, const cinema::Char* end, cinema::Float& r)
+{
+	static const cinema::Float pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	cinema::Bool neg = false;
+	if (s < end && (*s == '+' || *s == '-'))
+		neg = *s++ == '-';
+
+	cinema::UInt64 mantissa = 0;
+	cinema::Int32	 exp10 = 0;
+	cinema::Bool	 digits = false;
+
+	for (; s < end && *s >= '0' && *s <= '9'; s++, digits = true)
+	{
+		if (mantissa < 100000000000000000ULL)
+			mantissa = mantissa * 10 + cinema::UInt64(*s - '0');
+		else
+			exp10++;
+	}
+
+	if (s < end && *s == '.')
+	{
+		for (s++; s < end && *s >= '0' && *s <= '9'; s++, digits = true)
+		{
+			if (mantissa < 100000000000000000ULL)
+			{
+				mantissa = mantissa * 10 + cinema::UInt64(*s - '0');
+				exp10--;
+			}
+		}
+	}
+
+	if (!digits)
+		return false;
+
+	if (s < end && (*s == 'e' || *s == 'E'))
+	{
+		cinema::Bool	expNeg = false;
+		cinema::Int32 e = 0;
+
+		s++;
+		if (s < end && (*s == '+' || *s == '-'))
+			expNeg = *s++ == '-';
+		if (s >= end)
+			return false;
+
+		for (; s < end && *s >= '0' && *s <= '9'; s++)
+		{
+			if (e < 10000)
+				e = e * 10 + cinema::Int32(*s - '0');
+		}
+		exp10 += expNeg ? -e : e;
+	}
+
+	if (s != end)
+		return false;
+
+	cinema::Float v = cinema::Float(mantissa);
+	if (exp10 < 0)
+		v /= -exp10 < 23 ? pow10[-exp10] : maxon::Pow(10.0, cinema::Float(-exp10));
+	else if (exp10 > 0)
+		v *= exp10 < 23 ? pow10[exp10] : maxon::Pow(10.0, cinema::Float(exp10));
+
+	r = neg ? -v : v;
+	return true;
+}
+
+// maximum number of characters written by WriteFloat(), e.g. "-1.23456789e+38"
+#define STL_FLOAT_SIZE 15
+
+//----------------------------------------------------------------------------------------
+/// Locale independent counterpart of ParseFloat() for the export, writes the value in the
+/// format of printf("%.8e"). The 9 significant digits restore every Float32, but as the powers
+/// of ten above 1e22 are not exact the last digit may differ from printf for large exponents.
+/// @param[out] dst								The text, needs space for STL_FLOAT_SIZE characters.
+/// @param[in] v									The value.
+/// @return												The end of the text, it is not terminated.
+//----------------------------------------------------------------------------------------
+inline cinema::Char* WriteFloat(cinema::Char* dst, cinema::Float32 v)
+{
+	static const cinema::Float64 pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27, 1e28, 1e29, 1e30, 1e31, 1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39, 1e40, 1e41, 1e42, 1e43, 1e44, 1e45,
+		1e46, 1e47, 1e48, 1e49, 1e50, 1e51, 1e52, 1e53 };
+
+	cinema::Float64 d = v;
+	if (d < 0.0 || (d == 0.0 && 1.0 / d < 0.0))
+	{
+		*dst++ = '-';
+		d = -d;
+	}
+
+	if (d != d || d > cinema::Float64(maxon::LIMIT<cinema::Float32>::MAX))
+	{
+		const cinema::Char* s = d != d ? "nan" : "inf";
+		while (*s)
+			*dst++ = *s++;
+		return dst;
+	}
+
+	// the 9 digits are rounded to an integer, ties to even. The estimated exponent is corrected
+	// if it is off by one
+	cinema::UInt32 digits = 0;
+	cinema::Int32	 exp10 = 0;
+	if (d > 0.0)
+	{
+		exp10 = cinema::Int32(maxon::Floor(maxon::Log10(d)));
+		for (;;)
+		{
+			const cinema::Int32		shift = 8 - exp10;
+			const cinema::Float64 x = shift >= 0 ? d * pow10[shift] : d / pow10[-shift];
+			cinema::Float64				m = maxon::Floor(x);
+			if (x - m > 0.5 || (x - m == 0.5 && m != 2.0 * maxon::Floor(m * 0.5)))
+				m += 1.0;
+
+			if (m >= 1e9)
+				exp10++;
+			else if (m < 1e8)
+				exp10--;
+			else
+			{
+				digits = cinema::UInt32(m);
+				break;
+			}
+		}
+	}
+
+	cinema::Char mantissa[9];
+	for (cinema::Int32 i = 8; i >= 0; i--, digits /= 10)
+		mantissa[i] = cinema::Char('0' + digits % 10);
+
+	*dst++ = mantissa[0];
+	*dst++ = '.';
+	for (cinema::Int32 i = 1; i < 9; i++)
+		*dst++ = mantissa[i];
+
+	// the exponent of a Float32 has at most 2 digits
+	*dst++ = 'e';
+	*dst++ = exp10 < 0 ? '-' : '+';
+	exp10	 = exp10 < 0 ? -exp10 : exp10;
+	*dst++ = cinema::Char('0' + exp10 / 10);
+	*dst++ = cinema::Char('0' + exp10 % 10);
+
+	return dst;
+}
+
+//----------------------------------------------------------------------------------------
+/// Checks if a facet starts at a position. The "facet" keyword has to be followed by "normal",
+/// so neither "endfacet" nor a solid name like "solid facet" is taken for a facet.
+/// @param[in] pos								The position.
+/// @param[in] begin							Start of the text.
+/// @param[in] end								End of the text.
+/// @return												True if "facet normal" starts at pos.
+//----------------------------------------------------------------------------------------
+inline cinema::Bool IsFacet(const cinema::Char* pos, const cinema::Char* begin, const cinema::Char* end)
+{
+	if (end - pos < 5 || (pos > begin && !IsSeparator(pos[-1])) || !IsKeyword(pos, 5, "FACET"))
+		return false;
+
+	const cinema::Char* next = pos + 5;
+	if (next == end || !IsSeparator(*next))
+		return false;
+	while (next < end && IsSeparator(*next))
+		next++;
+
+	return end - next >= 6 && IsKeyword(next, 6, "NORMAL") && (next + 6 == end || IsSeparator(next[6]));
+}
+
+//----------------------------------------------------------------------------------------
+/// Finds the first facet, see IsFacet().
+/// @param[in] pos								Start of the search.
+/// @param[in] begin							Start of the text.
+/// @param[in] end								End of the text.
+/// @return												Start of the first facet at or after pos, or end if there is none.
+//----------------------------------------------------------------------------------------
+inline const cinema::Char* FindFacet(const cinema::Char* pos, const cinema::Char* begin, const cinema::Char* end)
+{
+	for (; pos + 5 <= end; pos++)
+	{
+		if (IsFacet(pos, begin, end))
+			return pos;
+	}
+	return end;
+}
+
+//----------------------------------------------------------------------------------------
+/// Finds the last facet, see IsFacet(). A facet whose "normal" is not in the text yet is not found.
+/// @param[in] begin							Start of the text.
+/// @param[in] end								End of the text.
+/// @return												Start of the last facet after begin, or end if there is none.
+//----------------------------------------------------------------------------------------
+inline const cinema::Char* FindLastFacet(const cinema::Char* begin, const cinema::Char* end)
+{
+	for (const cinema::Char* pos = end - 5; pos > begin; pos--)
+	{
+		if (IsFacet(pos, begin, end))
+			return pos;
+	}
+	return end;
+}
+
+#endif // STL_PARSER_H__
@@ -0,0 +1,143 @@
+// local header files
+#include "particlevolume_bvh.h"
+
+// Maxon API header files
+#include "maxon/unittest.h"
+#include "maxon/lib_math.h"
+
+namespace maxon
+{
+// ------------------------------------------------------------------------
+/// A unit test for ParticleBVH.
+/// Compares the coverage returned by the hierarchy with the brute-force path.
+/// Can be run with command line argument g_runUnitTests=*particlevolumebvh*.
+// ------------------------------------------------------------------------
+class ParticleVolumeBVHUnitTest : public UnitTestComponent<ParticleVolumeBVHUnitTest>
+{
+	MAXON_COMPONENT();
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to shoot random rays through a random particle
+	/// cloud and to compare the coverage of both paths.
+	/// @param[in] count							Number of particles.
+	/// @param[in] radius							Maximum radius of the particles.
+	/// @param[in] extent							The particles are placed in a cube of this size around the origin.
+	/// @param[in] seed								Seed of the random generator.
+	/// @return												OK if all results are equal.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareCoverage(Int count, Float radius, Float extent, Int32 seed)
+	{
+		iferr_scope;
+
+		cinema::Random rnd;
+		rnd.Init(seed);
+
+		ParticleSpheres particles;
+		particles.Resize(count) iferr_return;
+		for (Int i = 0; i < count; i++)
+			particles.Set(i, (Vector(rnd.Get01(), rnd.Get01(), rnd.Get01()) - Vector(0.5)) * extent, radius * (0.5 + 0.5 * rnd.Get01()));
+
+		ParticleBVH bvh;
+		bvh.Build(particles) iferr_return;
+
+		if (bvh.GetCount() != count)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Wrong particle count."_s);
+
+		for (Int i = 0; i < 1000; i++)
+		{
+			// rays start outside and inside of the cloud, every tenth ray is axis parallel
+			cinema::Ray ray;
+			ray.p = (Vector(rnd.Get01(), rnd.Get01(), rnd.Get01()) - Vector(0.5)) * extent * 2.0;
+			if (i % 10 == 0)
+				ray.v = Vector(0.0, 0.0, 1.0);
+			else
+				ray.v = (Vector(rnd.Get01(), rnd.Get01(), rnd.Get01()) - Vector(0.5)).GetNormalized();
+
+			const Float maxdist = rnd.Get01() * extent * 2.0;
+
+			const Float expected = GetCoverageBruteForce(particles, &ray, maxdist);
+			const Float result	 = bvh.GetCoverage(&ray, maxdist);
+
+			if (!CompareFloatTolerant(result, expected))
+				return UnitTestError(MAXON_SOURCE_LOCATION, "Coverage does not match."_s);
+		}
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to test a cloud of particles at the same position.
+	/// @return												OK if the result equals the brute-force result.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareCoincident()
+	{
+		iferr_scope;
+
+		ParticleSpheres particles;
+		particles.Resize(100) iferr_return;
+		for (Int i = 0; i < particles.GetCount(); i++)
+			particles.Set(i, Vector(10.0, 0.0, 0.0), 20.0);
+
+		ParticleBVH bvh;
+		bvh.Build(particles) iferr_return;
+
+		cinema::Ray ray;
+		ray.p = Vector(-100.0, 0.0, 0.0);
+		ray.v = Vector(1.0, 0.0, 0.0);
+
+		const Float expected = GetCoverageBruteForce(particles, &ray, 500.0);
+		if (!CompareFloatTolerant(bvh.GetCoverage(&ray, 500.0), expected))
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Coverage does not match."_s);
+
+		return OK;
+	}
+
+public:
+	MAXON_METHOD Result<void> Run()
+	{
+		iferr_scope;
+
+		MAXON_SCOPE
+		{
+			// empty hierarchy
+			ParticleBVH				 bvh;
+			cinema::Ray				 ray;
+			ray.p = Vector(0.0);
+			ray.v = Vector(0.0, 0.0, 1.0);
+			const Result<void> res = bvh.GetCoverage(&ray, 100.0) == 0.0 ? OK : UnitTestError(MAXON_SOURCE_LOCATION, "Coverage of empty hierarchy."_s);
+			self.AddResult("Empty"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			// fewer particles than a leaf holds
+			const Result<void> res = CompareCoverage(3, 50.0, 500.0, 1);
+			self.AddResult("Single leaf"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			// sparse cloud
+			const Result<void> res = CompareCoverage(1000, 5.0, 1000.0, 2);
+			self.AddResult("Sparse"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			// dense cloud with many overlapping spheres
+			const Result<void> res = CompareCoverage(5000, 50.0, 200.0, 3);
+			self.AddResult("Dense"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			// all particles at the same position, the hierarchy cannot split them
+			const Result<void> res = CompareCoincident();
+			self.AddResult("Coincident"_s, res);
+		}
+
+		return OK;
+	}
+};
+
+// ------------------------------------------------------------------------
+/// Registers the unit test at UnitTestClasses.
+// ------------------------------------------------------------------------
+MAXON_COMPONENT_CLASS_REGISTER(ParticleVolumeBVHUnitTest, UnitTestClasses, "net.maxonexample.unittest.particlevolumebvh");
+}
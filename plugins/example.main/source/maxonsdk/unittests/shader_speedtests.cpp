@@ -0,0 +1,222 @@
+// Maxon API header files
+#include "maxon/finally.h"
+#include "maxon/parallelfor.h"
+#include "maxon/unittest.h"
+
+// Cinema API header files
+#include "c4d.h"
+#include "xbitmapdistortion.h"
+#include "xmandelbrot.h"
+#include "xsdkgradient.h"
+
+// local header files
+#include "particlevolume_bvh.h"
+#include "shaderids.h"
+
+namespace maxon
+{
+// number of samples each job evaluates per measurement
+static const Int SPEEDTEST_SAMPLES = 1 << 18;
+
+// ------------------------------------------------------------------------
+/// A speed test for the SDK shaders. Every shader is driven through
+/// InitRender/Sample/FreeRender with a synthetic stream of ChannelData,
+/// outside of a render. For 1, 2, 4 ... threads it reports the samples per
+/// second, and for a single thread the process wide allocations per sample.
+/// The particle volume has no ChannelData interface, its coverage queries
+/// are measured on a synthetic particle cloud instead.
+/// Can be run with command line argument g_runSpeedTests=*shader*.
+// ------------------------------------------------------------------------
+class ShaderSpeedTest : public UnitTestComponent<ShaderSpeedTest>
+{
+	MAXON_COMPONENT();
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to run a job per thread and to report the throughput.
+	/// @param[in] name								Name of the measurement.
+	/// @param[in] job								Evaluates SPEEDTEST_SAMPLES samples, gets the job index.
+	/// @return												OK on success.
+	//----------------------------------------------------------------------------------------
+	template <typename JOB> Result<void> Measure(const String& name, JOB&& job)
+	{
+		iferr_scope;
+
+		// allocations of a single threaded pass
+		cinema::BaseContainer stat;
+		cinema::GeGetMemoryStat(stat);
+		const Int64 allocsBefore = stat.GetInt64(cinema::C4D_MEMORY_STAT_NO_OF_ALLOCATIONS_TOTAL);
+		job(0);
+		cinema::GeGetMemoryStat(stat);
+		const Int64 allocs = stat.GetInt64(cinema::C4D_MEMORY_STAT_NO_OF_ALLOCATIONS_TOTAL) - allocsBefore;
+
+		// the statistic is process wide, allocations of other threads running at the same time are included
+		ApplicationOutput("@: @ allocations per 1000 samples (process wide)", name, Float(allocs) * 1000.0 / SPEEDTEST_SAMPLES);
+
+		// per thread scaling
+		const Int threadCount = ThreadRef::GetCurrentThreadCount();
+		for (Int threads = 1;; threads = Min(threads * 2, threadCount))
+		{
+			const TimeValue start = TimeValue::GetTime();
+			ParallelFor::Dynamic(0, threads, job, ParallelFor::Granularity(1));
+			const Float seconds = (TimeValue::GetTime() - start).GetSeconds();
+
+			const Float samplesPerSecond = seconds > 0.0 ? Float(threads * SPEEDTEST_SAMPLES) / seconds : 0.0;
+			ApplicationOutput("@: @ threads, @ samples/s", name, threads, samplesPerSecond);
+
+			if (threads == threadCount)
+				break;
+		}
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to benchmark a shader.
+	/// @param[in] name								Name of the measurement.
+	/// @param[in] doc								Document that contains the shader.
+	/// @param[in] shader							The shader.
+	/// @return												OK on success.
+	//----------------------------------------------------------------------------------------
+	Result<void> BenchmarkShader(const String& name, cinema::BaseDocument* doc, cinema::BaseShader* shader)
+	{
+		iferr_scope;
+
+		cinema::InitRenderStruct irs(doc);
+		if (shader->InitRender(irs) != cinema::INITRENDERRESULT::OK)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "InitRender failed."_s);
+
+		finally
+		{
+			shader->FreeRender();
+		};
+
+		// a jittered scanline stream over UV [0..1]
+		const Int	 res = 512;
+		const auto job = [shader, res](Int index)
+		{
+			cinema::ChannelData cd;
+			cd.d = Vector(1.0 / res, 1.0 / res, 0.0);
+			cd.t = 0.0;
+			cd.texflag = 0;
+			cd.vd = nullptr;
+			cd.off = cd.scale = 0.0;
+
+			cinema::Random rnd;
+			rnd.Init((cinema::UInt32)index);
+
+			for (Int i = 0; i < SPEEDTEST_SAMPLES; i++)
+			{
+				const Int x = i % res, y = (i / res) % res;
+				cd.p = Vector((x + rnd.Get01()) / res, (y + rnd.Get01()) / res, 0.0);
+				shader->Sample(&cd);
+			}
+		};
+
+		Measure(name, job) iferr_return;
+		self.AddResult(name, OK);
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to benchmark the particle volume coverage queries.
+	/// @return												OK on success.
+	//----------------------------------------------------------------------------------------
+	Result<void> BenchmarkParticleVolume()
+	{
+		iferr_scope;
+
+		cinema::Random rnd;
+		rnd.Init(1);
+
+		ParticleSpheres particles;
+		particles.Resize(100000) iferr_return;
+		for (Int i = 0; i < particles.GetCount(); i++)
+			particles.Set(i, (Vector(rnd.Get01(), rnd.Get01(), rnd.Get01()) - Vector(0.5)) * 5000.0, 50.0);
+
+		ParticleBVH bvh;
+		bvh.Build(particles) iferr_return;
+
+		const auto job = [&bvh](Int index)
+		{
+			cinema::Random rnd;
+			rnd.Init((cinema::UInt32)index);
+
+			for (Int i = 0; i < SPEEDTEST_SAMPLES; i++)
+			{
+				cinema::Ray ray;
+				ray.p = (Vector(rnd.Get01(), rnd.Get01(), rnd.Get01()) - Vector(0.5)) * 5000.0;
+				ray.v = (Vector(rnd.Get01(), rnd.Get01(), rnd.Get01()) - Vector(0.5)).GetNormalized();
+				bvh.GetCoverage(&ray, 1000.0);
+			}
+		};
+
+		Measure("Particle Volume"_s, job) iferr_return;
+		self.AddResult("Particle Volume"_s, OK);
+
+		return OK;
+	}
+
+public:
+	MAXON_METHOD Result<void> Run()
+	{
+		iferr_scope;
+
+		cinema::AutoAlloc<cinema::BaseDocument> doc;
+		if (!doc)
+			return OutOfMemoryError(MAXON_SOURCE_LOCATION);
+
+		// the shaders are owned by a material of the document so that links can be resolved
+		cinema::BaseMaterial* mat = cinema::BaseMaterial::Alloc(cinema::Mmaterial);
+		if (!mat)
+			return OutOfMemoryError(MAXON_SOURCE_LOCATION);
+		doc->InsertMaterial(mat);
+
+		cinema::BaseShader* mandelbrot = cinema::BaseShader::Alloc(ID_MANDELBROT);
+		cinema::BaseShader* gradient = cinema::BaseShader::Alloc(ID_SDKGRADIENT);
+		cinema::BaseShader* bitmap = cinema::BaseShader::Alloc(ID_BITMAPDISTORTION);
+		cinema::BaseShader* child = cinema::BaseShader::Alloc(ID_MANDELBROT);
+		if (!mandelbrot || !gradient || !bitmap || !child)
+		{
+			cinema::BaseShader::Free(mandelbrot);
+			cinema::BaseShader::Free(gradient);
+			cinema::BaseShader::Free(bitmap);
+			cinema::BaseShader::Free(child);
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Could not allocate the shaders."_s);
+		}
+
+		mat->InsertShader(mandelbrot);
+		mat->InsertShader(gradient);
+		mat->InsertShader(bitmap);
+		bitmap->InsertShader(child);
+
+		gradient->GetDataInstanceRef().SetFloat(SDKGRADIENTSHADER_TURBULENCE, 0.5);
+		bitmap->GetDataInstanceRef().SetFloat(BITMAPDISTORTIONSHADER_NOISE, 0.5);
+		bitmap->GetDataInstanceRef().SetLink(BITMAPDISTORTIONSHADER_TEXTURE, child);
+
+		BenchmarkShader("Mandelbrot"_s, doc, mandelbrot) iferr_return;
+
+		mandelbrot->GetDataInstanceRef().SetBool(MANDELBROTSHADER_BAKE, true);
+		BenchmarkShader("Mandelbrot (baked)"_s, doc, mandelbrot) iferr_return;
+
+		BenchmarkShader("Gradient"_s, doc, gradient) iferr_return;
+
+		gradient->GetDataInstanceRef().SetBool(SDKGRADIENTSHADER_LATTICE, true);
+		BenchmarkShader("Gradient (baked turbulence)"_s, doc, gradient) iferr_return;
+
+		BenchmarkShader("Bitmap Distortion"_s, doc, bitmap) iferr_return;
+
+		bitmap->GetDataInstanceRef().SetBool(BITMAPDISTORTIONSHADER_CACHE, true);
+		BenchmarkShader("Bitmap Distortion (cached field)"_s, doc, bitmap) iferr_return;
+
+		BenchmarkParticleVolume() iferr_return;
+
+		return OK;
+	}
+};
+
+// ------------------------------------------------------------------------
+/// Registers the speed test at SpeedTestClasses.
+// ------------------------------------------------------------------------
+MAXON_COMPONENT_CLASS_REGISTER(ShaderSpeedTest, SpeedTestClasses, "net.maxonexample.speedtest.shader");
+}
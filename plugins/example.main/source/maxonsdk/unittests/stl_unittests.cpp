@@ -0,0 +1,316 @@
+// local header files
+#include "stl_parser.h"
+
+// Maxon API header files
+#include "maxon/unittest.h"
+
+namespace maxon
+{
+// ------------------------------------------------------------------------
+/// A unit test for the ASCII parser of the STL import and the numbers of the export.
+/// Checks the number parser and writer, the facet search that splits a file into
+/// chunks and the detection of binary files whose header starts with "solid".
+/// Can be run with command line argument g_runUnitTests=*stl*.
+// ------------------------------------------------------------------------
+class STLParserUnitTest : public UnitTestComponent<STLParserUnitTest>
+{
+	MAXON_COMPONENT();
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to parse a number.
+	/// @param[in] text								The number.
+	/// @param[in] expected						The expected value.
+	/// @return												OK if the value matches up to the precision of a Float.
+	//----------------------------------------------------------------------------------------
+	static Result<void> CheckFloat(const Char* text, Float expected)
+	{
+		Float r = 0.0;
+		if (!ParseFloat(text, text + strlen(text), r))
+			return UnitTestError(MAXON_SOURCE_LOCATION, FormatString("@ was not parsed.", String(text)));
+		if (Abs(r - expected) > Abs(expected) * 1e-15)
+			return UnitTestError(MAXON_SOURCE_LOCATION, FormatString("@ was parsed as @.", String(text), r));
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to check numbers with and without exponent.
+	/// @return												OK if all numbers are parsed correctly.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareNumbers()
+	{
+		iferr_scope;
+
+		CheckFloat("0", 0.0) iferr_return;
+		CheckFloat("7", 7.0) iferr_return;
+		CheckFloat("+7", 7.0) iferr_return;
+		CheckFloat("-1.5", -1.5) iferr_return;
+		CheckFloat("-0.0", 0.0) iferr_return;
+		CheckFloat(".5", 0.5) iferr_return;
+		CheckFloat("5.", 5.0) iferr_return;
+		CheckFloat("1.5e3", 1500.0) iferr_return;
+		CheckFloat("1.5E+3", 1500.0) iferr_return;
+		CheckFloat("-2.5e-3", -0.0025) iferr_return;
+		CheckFloat("6.02214076e23", 6.02214076e23) iferr_return;
+		CheckFloat("-1.00000000e+00", -1.0) iferr_return;
+		CheckFloat("1e300", 1e300) iferr_return;
+		CheckFloat("1e-300", 1e-300) iferr_return;
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to check numbers with more than 18 significant digits.
+	/// @return												OK if all numbers are parsed correctly.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareLongNumbers()
+	{
+		iferr_scope;
+
+		CheckFloat("12345678901234567890123", 1.2345678901234567890123e22) iferr_return;
+		CheckFloat("-98765432109876543210.5e-10", -9876543210.98765432105) iferr_return;
+		CheckFloat("0.1234567890123456789012345", 0.1234567890123456789012345) iferr_return;
+		CheckFloat("0.000000000000000000001", 1e-21) iferr_return;
+		CheckFloat("00000000000000000000012.5", 12.5) iferr_return;
+		CheckFloat("3.14159265358979323846264338327950288", 3.14159265358979323846) iferr_return;
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to check that malformed numbers are rejected.
+	/// @return												OK if no text is parsed as a number.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareInvalidNumbers()
+	{
+		const Char* const texts[] = { "", "-", ".", "+.e1", "e5", "1e", "1e+", "1.5x", "1,5", "0x10", "nan" };
+
+		for (const Char* text : texts)
+		{
+			Float r = 0.0;
+			if (ParseFloat(text, text + strlen(text), r))
+				return UnitTestError(MAXON_SOURCE_LOCATION, FormatString("@ was parsed as a number.", String(text)));
+		}
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to check the numbers of the export. Values with exact digits
+	/// are compared with the output of printf("%.8e"), random values have to be parsed back
+	/// to the same Float32.
+	/// @return												OK if all numbers are written correctly.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareWrittenNumbers()
+	{
+		struct Expected
+		{
+			Float32			v;
+			const Char* text;
+		};
+		const Expected expected[] = {
+			{ 0.0f, "0.00000000e+00" }, { -0.0f, "-0.00000000e+00" }, { 1.0f, "1.00000000e+00" }, { -1.5f, "-1.50000000e+00" },
+			{ 0.1f, "1.00000001e-01" }, { 1e10f, "1.00000000e+10" }, { 277088.8125f, "2.77088812e+05" }, { 7034.578125f, "7.03457812e+03" },
+			{ 3.40282347e38f, "3.40282347e+38" }, { 1.17549435e-38f, "1.17549435e-38" }, { 1.40129846e-45f, "1.40129846e-45" }
+		};
+
+		Char text[STL_FLOAT_SIZE + 1];
+		for (const Expected& e : expected)
+		{
+			*WriteFloat(text, e.v) = 0;
+			if (strcmp(text, e.text) != 0)
+				return UnitTestError(MAXON_SOURCE_LOCATION, FormatString("@ was written as @.", String(e.text), String(text)));
+		}
+
+		// random bit patterns cover all exponents, infinity and NaN are skipped
+		cinema::Random rnd;
+		rnd.Init(1234);
+		for (Int i = 0; i < 100000; i++)
+		{
+			const UInt32 bits = UInt32(rnd.Get01() * 4294967295.0);
+			Float32			 v;
+			MemCopy(&v, &bits, sizeof(v));
+			if ((bits & 0x7f800000) == 0x7f800000)
+				continue;
+
+			Float					r = 0.0;
+			const Char* end = WriteFloat(text, v);
+			if (end - text > STL_FLOAT_SIZE || !ParseFloat(text, end, r) || Float32(r) != v)
+				return UnitTestError(MAXON_SOURCE_LOCATION, FormatString("@ was not restored.", v));
+		}
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to check the facet search. "endfacet" and a solid name
+	/// that contains or is "facet" must not be taken for the start of a facet.
+	/// @return												OK if all facets are found.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareFacets()
+	{
+		const Char* const text =
+			"solid endfacet_facets\n"
+			"facet normal 0 0 1\n outer loop\n  vertex 0 0 0\n  vertex 1 0 0\n  vertex 0 1 0\n endloop\nendfacet\n"
+			"FaCeT\tnormal 0 0 1\n outer loop\n  vertex 0 0 0\n  vertex 1 0 0\n  vertex 0 1 0\n endloop\nendfacet\n"
+			"endsolid endfacet_facets\n";
+
+		const Char* begin = text;
+		const Char* end = text + strlen(text);
+		const Char* first = strstr(text, "\nfacet") + 1;
+		const Char* last = strstr(text, "\nFaCeT") + 1;
+
+		if (FindFacet(begin, begin, end) != first)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "First facet not found."_s);
+		if (FindFacet(first, first, end) != first)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Facet at the start of the text not found."_s);
+		if (FindFacet(first + 1, begin, end) != last)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Second facet not found."_s);
+		if (FindFacet(last + 1, begin, end) != end)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Facet found after the last one."_s);
+
+		if (FindLastFacet(begin, end) != last)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Last facet not found."_s);
+		if (FindLastFacet(begin, last + 12) != last)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Facet at the end of the text not found."_s);
+		if (FindLastFacet(begin, last + 5) != first)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Facet without normal at the end of the text taken for a facet."_s);
+		if (FindLastFacet(begin, last) != first)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Facet before endfacet not found."_s);
+		if (FindLastFacet(first + 1, last - 1) != last - 1)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Endfacet at the end of the text taken for a facet."_s);
+		if (FindLastFacet(begin, first + 4) != first + 4)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Part of a keyword taken for a facet."_s);
+
+		// a later window whose carried rest starts with the only facet has no facet after its start
+		if (FindLastFacet(first, first + 20) != first + 20)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Facet at the start of the text returned."_s);
+		if (FindLastFacet(first, last) != last)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Facet at the start of a window returned."_s);
+
+		// a solid named "facet" is no facet
+		const Char* const named =
+			"solid facet\n"
+			"facet normal 0 0 1\n outer loop\n  vertex 0 0 0\n  vertex 1 0 0\n  vertex 0 1 0\n endloop\nendfacet\n"
+			"endsolid facet\n";
+
+		const Char* namedEnd = named + strlen(named);
+		const Char* namedFacet = strstr(named, "\nfacet") + 1;
+
+		if (FindFacet(named, named, namedEnd) != namedFacet)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Solid name taken for a facet."_s);
+		if (FindLastFacet(named, namedEnd) != namedFacet)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Name of endsolid taken for a facet."_s);
+		if (FindLastFacet(named, namedFacet) != namedFacet)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Solid name at the end of the text taken for a facet."_s);
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to tokenize a text up to its end or up to a binary character.
+	/// @param[in] begin							Start of the text.
+	/// @param[in] end								End of the text.
+	/// @param[out] tokens						Number of tokens.
+	/// @return												True if the text has characters of a binary file.
+	//----------------------------------------------------------------------------------------
+	static Bool Tokenize(const Char* begin, const Char* end, Int& tokens)
+	{
+		const Char* pos = begin;
+		const Char* token;
+		Int					len;
+		Bool				binary = false;
+
+		tokens = 0;
+		while (NextToken(pos, end, token, len, binary))
+			tokens++;
+
+		return binary;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to check that a binary file whose header starts with "solid"
+	/// is detected by its size and by the tokenizer, so that the import falls back to the binary loader.
+	/// @return												OK if the binary file is detected and the ASCII file is not.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareBinaryHeader()
+	{
+		iferr_scope;
+
+		// 80 byte header, triangle count and two records
+		BaseArray<Char> file;
+		file.Resize(STL_BINARY_HEADER + 4 + 2 * STL_BINARY_RECORD) iferr_return;
+		ClearMem(file.GetFirst(), file.GetCount());
+
+		const Char header[] = "solid exported by a binary writer";
+		MemCopy(file.GetFirst(), header, sizeof(header) - 1);
+		file[STL_BINARY_HEADER] = 2;
+
+		const Float32 record[12] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+		MemCopy(file.GetFirst() + STL_BINARY_HEADER + 4, record, sizeof(record));
+		MemCopy(file.GetFirst() + STL_BINARY_HEADER + 4 + STL_BINARY_RECORD, record, sizeof(record));
+
+		if (!IsBinarySize(2, file.GetCount()))
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Binary file size not detected."_s);
+		if (IsBinarySize(2, file.GetCount() + 1) || IsBinarySize(3, file.GetCount()) || IsBinarySize(0, STL_BINARY_HEADER + 4))
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Wrong size taken for a binary file."_s);
+
+		Int tokens;
+		if (!Tokenize(file.GetFirst(), file.GetFirst() + file.GetCount(), tokens))
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Binary file not detected."_s);
+		if (tokens != 5)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Wrong number of header tokens."_s);
+
+		const Char* const text = "solid ascii\nfacet normal 0 0 1\nendfacet\nendsolid ascii\n";
+		if (Tokenize(text, text + strlen(text), tokens))
+			return UnitTestError(MAXON_SOURCE_LOCATION, "ASCII file taken for a binary file."_s);
+		if (tokens != 10)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Wrong number of tokens."_s);
+
+		return OK;
+	}
+
+public:
+	MAXON_METHOD Result<void> Run()
+	{
+		iferr_scope;
+
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareNumbers();
+			self.AddResult("Numbers"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareLongNumbers();
+			self.AddResult("More than 18 digits"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareInvalidNumbers();
+			self.AddResult("Invalid numbers"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareWrittenNumbers();
+			self.AddResult("Written numbers"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareFacets();
+			self.AddResult("Facet boundaries"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareBinaryHeader();
+			self.AddResult("Binary file with solid header"_s, res);
+		}
+
+		return OK;
+	}
+};
+
+// ------------------------------------------------------------------------
+/// Registers the unit test at UnitTestClasses.
+// ------------------------------------------------------------------------
+MAXON_COMPONENT_CLASS_REGISTER(STLParserUnitTest, UnitTestClasses, "net.maxonexample.unittest.stl");
+}
@@ -0,0 +1,139 @@
+#ifndef SYNTHETIC_LINEBUFFER_H__
+#define SYNTHETIC_LINEBUFFER_H__
+
+// Maxon API header files
+#include "maxon/basearray.h"
+
+// Cinema API header files
+#include "c4d.h"
+
+namespace maxon
+{
+// ------------------------------------------------------------------------
+/// A buffer with the line interface of VPBuffer for the tests of the video posts.
+/// The lines are stored at the bit depth of the buffer and converted to the
+/// requested bit depth like VPBuffer does. The GetLine() and SetLine() calls
+/// and the bytes they copy are counted per row, a row is only accessed by
+/// one block at a time.
+// ------------------------------------------------------------------------
+class SyntheticLineBuffer
+{
+public:
+	Result<void> Init(Int32 width, Int32 height, Int32 cpp, Int32 bitdepth)
+	{
+		iferr_scope;
+
+		_width = width;
+		_cpp = cpp;
+		_bitdepth = bitdepth;
+
+		const Int count = Int(width) * height * cpp;
+		_data.Resize(count * (bitdepth / 8)) iferr_return;
+
+		// small integer values, so that an increment is exact at every bit depth
+		for (Int i = 0; i < count; i++)
+		{
+			switch (bitdepth)
+			{
+				case 8: _data[i] = UChar(i % 200); break;
+				case 16: reinterpret_cast<UInt16*>(_data.GetFirst())[i] = UInt16(i % 1000); break;
+				default: reinterpret_cast<Float32*>(_data.GetFirst())[i] = Float32(i % 1000); break;
+			}
+		}
+
+		_reads.Resize(height) iferr_return;
+		_writes.Resize(height) iferr_return;
+		_bytes.Resize(height) iferr_return;
+		ResetCounters();
+
+		return OK;
+	}
+
+	Int GetInfo(cinema::VPGETINFO type) const
+	{
+		switch (type)
+		{
+			case cinema::VPGETINFO::CPP: return _cpp;
+			case cinema::VPGETINFO::BITDEPTH: return _bitdepth;
+			default: return 0;
+		}
+	}
+
+	Bool GetLine(Int32 x, Int32 y, Int32 cnt, void* data, Int32 bitdepth, Bool dithering)
+	{
+		Convert(GetPixel(x, y), _bitdepth, (UChar*)data, bitdepth, Int(cnt) * _cpp);
+		_reads[y]++;
+		_bytes[y] += Int(cnt) * _cpp * (bitdepth / 8);
+		return true;
+	}
+
+	Bool SetLine(Int32 x, Int32 y, Int32 cnt, void* data, Int32 bitdepth, Bool dithering)
+	{
+		Convert((const UChar*)data, bitdepth, GetPixel(x, y), _bitdepth, Int(cnt) * _cpp);
+		_writes[y]++;
+		_bytes[y] += Int(cnt) * _cpp * (bitdepth / 8);
+		return true;
+	}
+
+	UChar* GetPixel(Int32 x, Int32 y) { return _data.GetFirst() + (Int(y) * _width + x) * _cpp * (_bitdepth / 8); }
+	Int32 GetReads(Int32 y) const { return _reads[y]; }
+	Int32 GetWrites(Int32 y) const { return _writes[y]; }
+
+	Int64 GetBytes() const
+	{
+		Int64 sum = 0;
+		for (const Int64 b : _bytes)
+			sum += b;
+		return sum;
+	}
+
+	void ResetCounters()
+	{
+		for (Int i = 0; i < _bytes.GetCount(); i++)
+		{
+			_reads[i] = _writes[i] = 0;
+			_bytes[i] = 0;
+		}
+	}
+
+private:
+	static Float32 GetComponent(const UChar* data, Int i, Int32 bitdepth)
+	{
+		switch (bitdepth)
+		{
+			case 8: return Float32(data[i]) / 255.0f;
+			case 16: return Float32(reinterpret_cast<const UInt16*>(data)[i]) / 65535.0f;
+			default: return reinterpret_cast<const Float32*>(data)[i];
+		}
+	}
+
+	static void SetComponent(UChar* data, Int i, Int32 bitdepth, Float32 v)
+	{
+		switch (bitdepth)
+		{
+			case 8: data[i] = UChar(ClampValue(v, 0.0f, 1.0f) * 255.0f + 0.5f); break;
+			case 16: reinterpret_cast<UInt16*>(data)[i] = UInt16(ClampValue(v, 0.0f, 1.0f) * 65535.0f + 0.5f); break;
+			default: reinterpret_cast<Float32*>(data)[i] = v; break;
+		}
+	}
+
+	static void Convert(const UChar* src, Int32 srcDepth, UChar* dst, Int32 dstDepth, Int count)
+	{
+		if (srcDepth == dstDepth)
+		{
+			MemCopy(dst, src, count * (srcDepth / 8));
+			return;
+		}
+
+		for (Int i = 0; i < count; i++)
+			SetComponent(dst, i, dstDepth, GetComponent(src, i, srcDepth));
+	}
+
+	BaseArray<UChar> _data;
+	BaseArray<Int32> _reads, _writes;
+	BaseArray<Int64> _bytes;
+	Int32						 _width = 0, _cpp = 0, _bitdepth = 32;
+};
+}
+
+#endif // SYNTHETIC_LINEBUFFER_H__
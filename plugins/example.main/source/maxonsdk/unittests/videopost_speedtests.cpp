@@ -0,0 +1,284 @@
+// Maxon API header files
+#include "maxon/parallelfor.h"
+#include "maxon/unittest.h"
+
+// Cinema API header files
+#include "c4d.h"
+#include "vpcolorize.h"
+#include "vpinvertimage.h"
+
+// local header files
+#include "synthetic_linebuffer.h"
+#include "videopostids.h"
+#include "vpblock.h"
+#include "vpcolormatrix.h"
+#include "vpfused.h"
+
+namespace maxon
+{
+// number of rows of a block, as used by the video posts
+static const Int32 SPEEDTEST_ROW_BLOCK = 16;
+
+// number of passes over the image per measurement
+static const Int SPEEDTEST_PASSES = 4;
+
+// components of a sample of ExecuteLine, RGBA plus an alpha and an object buffer
+static const Int32 SPEEDTEST_LINE_COMPONENTS = 6;
+
+// offset of the alpha buffer in a sample of ExecuteLine
+static const Int32 SPEEDTEST_LINE_MASK = 4;
+
+// ------------------------------------------------------------------------
+/// A speed test for the SDK video posts, without a render. The kernel of
+/// the invert effect runs over a synthetic RGBA buffer of 8, 16 and 32 bit at
+/// several resolutions, ExecuteLine of the colorize effect runs over synthetic
+/// spans. The masked modes of the colorize effect need the buffers of a render,
+/// their kernel runs over the same spans with the alpha buffer as mask.
+/// For 1, 2, 4 ... threads it reports the megapixels per second and
+/// the bytes the buffer copied per pixel, the last line of every measurement
+/// is the pass of ProcessRowBlocks() the video posts use.
+/// The visualize normals effect needs the fragments of a render and is not
+/// part of the test.
+/// Can be run with command line argument g_runSpeedTests=*videopost*.
+// ------------------------------------------------------------------------
+class VideoPostSpeedTest : public UnitTestComponent<VideoPostSpeedTest>
+{
+	MAXON_COMPONENT();
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to report a measurement.
+	/// @param[in] name								Name of the measurement.
+	/// @param[in] threads						Number of threads, 0 for the pass of ProcessRowBlocks().
+	/// @param[in] pixels							Number of processed pixels.
+	/// @param[in] bytes							Number of bytes copied.
+	/// @param[in] seconds						Duration.
+	//----------------------------------------------------------------------------------------
+	static void Report(const String& name, Int threads, Int64 pixels, Int64 bytes, Float seconds)
+	{
+		const Float megapixels = seconds > 0.0 ? Float(pixels) / seconds / 1000000.0 : 0.0;
+		const Float bytesPerPixel = pixels > 0 ? Float(bytes) / Float(pixels) : 0.0;
+
+		if (threads > 0)
+			ApplicationOutput("@: @ threads, @ MP/s, @ bytes/pixel", name, threads, megapixels, bytesPerPixel);
+		else
+			ApplicationOutput("@: ProcessRowBlocks, @ MP/s, @ bytes/pixel", name, megapixels, bytesPerPixel);
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to benchmark a kernel over a synthetic RGBA buffer.
+	/// @param[in] name								Name of the measurement.
+	/// @param[in] kernel							The kernel.
+	/// @param[in] width							Width of the image.
+	/// @param[in] height							Height of the image.
+	/// @param[in] bitdepth						Bit depth of the buffer, the kernels get 32 bit rows.
+	/// @return												OK on success.
+	//----------------------------------------------------------------------------------------
+	Result<void> BenchmarkKernel(const String& name, const VPFusedKernel& kernel, Int32 width, Int32 height, Int32 bitdepth)
+	{
+		iferr_scope;
+
+		SyntheticLineBuffer buffer;
+		buffer.Init(width, height, 4, bitdepth) iferr_return;
+
+		const String fullName = FormatString("@ (@x@, @ bit)", name, width, height, bitdepth);
+		const Int64	 pixels = Int64(width) * height * SPEEDTEST_PASSES;
+
+		const auto fn = [&kernel](VPBlock& block) -> Result<void>
+		{
+			for (Int32 y = block.GetTop(); y <= block.GetBottom(); y++)
+			{
+				if (kernel.ProcessRow(block.GetRow<Float32>(y), nullptr, block.GetLeft(), y, block.GetWidth(), block.GetComponents()))
+					block.Touch(y);
+			}
+			return OK;
+		};
+
+		// every thread runs the blocks of a band of the image
+		BaseArray<VPBlock> pool;
+		const Int					 threadCount = ThreadRef::GetCurrentThreadCount();
+		pool.Resize(threadCount) iferr_return;
+
+		for (Int threads = 1;; threads = Min(threads * 2, threadCount))
+		{
+			const auto job = [&buffer, &pool, &fn, threads, width, height](Int index)
+			{
+				VPBlock&		block = pool[index];
+				const Int32 y1 = Int32(height * index / threads);
+				const Int32 y2 = Int32(height * (index + 1) / threads);
+
+				for (Int pass = 0; pass < SPEEDTEST_PASSES; pass++)
+				{
+					for (Int32 y = y1; y < y2; y += SPEEDTEST_ROW_BLOCK)
+					{
+						iferr (block.Load(&buffer, 0, y, width, Min(y2 - y, SPEEDTEST_ROW_BLOCK), 32))
+							return;
+						iferr (fn(block))
+							return;
+						block.Store(&buffer);
+					}
+				}
+			};
+
+			buffer.ResetCounters();
+			const TimeValue start = TimeValue::GetTime();
+			ParallelFor::Dynamic(0, threads, job, ParallelFor::Granularity(1));
+			Report(fullName, threads, pixels, buffer.GetBytes(), (TimeValue::GetTime() - start).GetSeconds());
+
+			if (threads == threadCount)
+				break;
+		}
+
+		// the pass the video posts run
+		buffer.ResetCounters();
+		const TimeValue start = TimeValue::GetTime();
+		for (Int pass = 0; pass < SPEEDTEST_PASSES; pass++)
+			ProcessRowBlocks(&buffer, 0, 0, width - 1, height - 1, SPEEDTEST_ROW_BLOCK, 32, pool, nullptr, fn) iferr_return;
+		Report(fullName, 0, pixels, buffer.GetBytes(), (TimeValue::GetTime() - start).GetSeconds());
+
+		self.AddResult(fullName, OK);
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to benchmark a line effect with synthetic spans.
+	/// @param[in] name								Name of the measurement.
+	/// @param[in] width							Number of pixels of a span.
+	/// @param[in] height							Number of spans of a pass.
+	/// @param[in] aa									True for spans with 4 sub-samples per pixel.
+	/// @param[in] fn									Called as fn(PixelPost* pp) for every span, like ExecuteLine.
+	/// @return												OK on success.
+	//----------------------------------------------------------------------------------------
+	template <typename FN> Result<void> BenchmarkSpans(const String& name, Int32 width, Int32 height, Bool aa, FN&& fn)
+	{
+		iferr_scope;
+
+		const String fullName = FormatString("@ (@x@@)", name, width, height, aa ? " AA"_s : ""_s);
+		const Int		 samples = Int(width) * (aa ? 4 : 1) * SPEEDTEST_LINE_COMPONENTS;
+		const Int64	 pixels = Int64(width) * height * SPEEDTEST_PASSES;
+
+		const Int					 threadCount = ThreadRef::GetCurrentThreadCount();
+		BaseArray<Float32> spans;
+		spans.Resize(samples * threadCount) iferr_return;
+		for (Int i = 0; i < spans.GetCount(); i++)
+			spans[i] = Float32(i % 200 + 20) / 256.0f;
+
+		for (Int threads = 1;; threads = Min(threads * 2, threadCount))
+		{
+			// every thread renders the spans of a band of the image
+			const auto job = [&fn, &spans, samples, threads, height, width, aa](Int index)
+			{
+				cinema::PixelPost pp;
+				pp.col = spans.GetFirst() + index * samples;
+				pp.comp = SPEEDTEST_LINE_COMPONENTS;
+				pp.xmin = 0;
+				pp.xmax = width - 1;
+				pp.aa = aa;
+
+				const Int32 y1 = Int32(height * index / threads);
+				const Int32 y2 = Int32(height * (index + 1) / threads);
+
+				for (Int pass = 0; pass < SPEEDTEST_PASSES; pass++)
+				{
+					for (Int32 y = y1; y < y2; y++)
+						fn(&pp);
+				}
+			};
+
+			const TimeValue start = TimeValue::GetTime();
+			ParallelFor::Dynamic(0, threads, job, ParallelFor::Granularity(1));
+
+			// every sample is read and written once
+			const Int64 bytes = Int64(samples) * SIZEOF(Float32) * 2 * height * SPEEDTEST_PASSES;
+			Report(fullName, threads, pixels, bytes, (TimeValue::GetTime() - start).GetSeconds());
+
+			if (threads == threadCount)
+				break;
+		}
+
+		self.AddResult(fullName, OK);
+
+		return OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to get the fused kernel of a video post.
+	/// @param[in] vp									The video post, its fuse option is enabled.
+	/// @return												The kernel.
+	//----------------------------------------------------------------------------------------
+	static Result<const VPFusedKernel*> GetKernel(cinema::BaseVideoPost* vp)
+	{
+		VPFusedKernelData data;
+		vp->Message(MSG_VPFUSED_GETKERNEL, &data);
+		if (!data.kernel)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Video post has no kernel."_s);
+
+		return data.kernel;
+	}
+
+public:
+	MAXON_METHOD Result<void> Run()
+	{
+		iferr_scope;
+
+		cinema::AutoAlloc<cinema::BaseVideoPost> invert(ID_INVERTVIDEOPOST);
+		cinema::AutoAlloc<cinema::BaseVideoPost> colorize(ID_COLORIZEVIDEOPOST);
+		if (!invert || !colorize)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Could not allocate the video posts."_s);
+
+		cinema::VideoPostData* colorizeData = colorize->GetNodeData<cinema::VideoPostData>();
+		if (!colorizeData)
+			return UnitTestError(MAXON_SOURCE_LOCATION, "Video post has no data."_s);
+
+		invert->GetDataInstanceRef().SetBool(VP_INVERTIMAGE_FUSE, true);
+		colorize->GetDataInstanceRef().SetInt32(VP_COLORIZE_MODE, VP_COLORIZE_MODE_COMPLETE);
+
+		// the colorize effect resolves its colour matrix when a frame sequence starts,
+		// the complete image mode needs no render for this
+		cinema::VideoPostStruct vps = {};
+		vps.vp = cinema::VIDEOPOSTCALL::FRAMESEQUENCE;
+		vps.open = true;
+		colorizeData->Execute(colorize, &vps);
+
+		const VPFusedKernel* invertKernel = GetKernel(invert) iferr_return;
+
+		const auto executeLine = [&colorize, colorizeData](cinema::PixelPost* pp)
+		{
+			colorizeData->ExecuteLine(colorize, pp);
+		};
+
+		// the matrix of the default settings, blended by the alpha of every sample
+		Float32 matrix[3][4];
+		SetColorizeMatrix(matrix, 0.2f, 0.0f, -0.2f);
+		const auto masked = [&matrix](cinema::PixelPost* pp)
+		{
+			const Int count = Int(pp->xmax - pp->xmin + 1) * (pp->aa ? 4 : 1);
+			ApplyColorMatrixMasked(matrix, pp->col, count, pp->comp, SPEEDTEST_LINE_MASK);
+		};
+
+		static const Int32 sizes[][2] = { { 640, 360 }, { 1920, 1080 }, { 3840, 2160 } };
+		static const Int32 depths[] = { 8, 16, 32 };
+
+		for (const auto& size : sizes)
+		{
+			for (const Int32 depth : depths)
+				BenchmarkKernel("Invert"_s, *invertKernel, size[0], size[1], depth) iferr_return;
+
+			BenchmarkSpans("Colorize ExecuteLine"_s, size[0], size[1], false, executeLine) iferr_return;
+			BenchmarkSpans("Colorize ExecuteLine"_s, size[0], size[1], true, executeLine) iferr_return;
+			BenchmarkSpans("Colorize Masked"_s, size[0], size[1], false, masked) iferr_return;
+			BenchmarkSpans("Colorize Masked"_s, size[0], size[1], true, masked) iferr_return;
+		}
+
+		vps.open = false;
+		colorizeData->Execute(colorize, &vps);
+
+		return OK;
+	}
+};
+
+// ------------------------------------------------------------------------
+/// Registers the speed test at SpeedTestClasses.
+// ------------------------------------------------------------------------
+MAXON_COMPONENT_CLASS_REGISTER(VideoPostSpeedTest, SpeedTestClasses, "net.maxonexample.speedtest.videopost");
+}
@@ -0,0 +1,120 @@
+// local header files
+#include "synthetic_linebuffer.h"
+#include "vpblock.h"
+
+// Maxon API header files
+#include "maxon/unittest.h"
+
+namespace maxon
+{
+// ------------------------------------------------------------------------
+/// A unit test for VPBlock and ProcessRowBlocks().
+/// Checks that every row of the rectangle is read once, that only touched
+/// rows are written back and that the rows are passed at the requested bit depth.
+/// Can be run with command line argument g_runUnitTests=*vpblock*.
+// ------------------------------------------------------------------------
+class VPBlockUnitTest : public UnitTestComponent<VPBlockUnitTest>
+{
+	MAXON_COMPONENT();
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to increment the first component of every pixel of the even rows.
+	/// @param[in] bitdepth						Native bit depth of the buffer.
+	/// @param[in] rowsPerBlock				Number of rows per block.
+	/// @return												OK if the buffer has the expected content.
+	//----------------------------------------------------------------------------------------
+	template <typename T> Result<void> CompareBlocks(Int32 bitdepth, Int32 rowsPerBlock)
+	{
+		iferr_scope;
+
+		const Int32 width = 40, height = 37, cpp = 4;
+		const Int32 x1 = 3, y1 = 2, x2 = 30, y2 = 34;
+
+		SyntheticLineBuffer buffer, original;
+		buffer.Init(width, height, cpp, bitdepth) iferr_return;
+		original.Init(width, height, cpp, bitdepth) iferr_return;
+
+		BaseArray<VPBlock> pool;
+
+		// the second pass reuses the blocks of the pool
+		for (Int32 pass = 0; pass < 2; pass++)
+		{
+			ProcessRowBlocks(&buffer, x1, y1, x2, y2, rowsPerBlock, 0, pool, nullptr,
+				[](VPBlock& block) -> Result<void>
+				{
+					for (Int32 y = block.GetTop(); y <= block.GetBottom(); y++)
+					{
+						if (y % 2 != 0)
+							continue;
+
+						T* row = block.GetRow<T>(y);
+						for (Int32 x = 0; x < block.GetWidth(); x++)
+							row[x * block.GetComponents()]++;
+						block.Touch(y);
+					}
+					return OK;
+				}) iferr_return;
+		}
+
+		for (Int32 y = 0; y < height; y++)
+		{
+			const Bool inside = y >= y1 && y <= y2;
+			if (buffer.GetReads(y) != (inside ? 2 : 0))
+				return UnitTestError(MAXON_SOURCE_LOCATION, "Wrong number of reads."_s);
+			if (buffer.GetWrites(y) != (inside && y % 2 == 0 ? 2 : 0))
+				return UnitTestError(MAXON_SOURCE_LOCATION, "Wrong number of writes."_s);
+
+			for (Int32 x = 0; x < width; x++)
+			{
+				const T* result = reinterpret_cast<const T*>(buffer.GetPixel(x, y));
+				const T* source = reinterpret_cast<const T*>(original.GetPixel(x, y));
+				const Bool changed = inside && y % 2 == 0 && x >= x1 && x <= x2;
+
+				for (Int32 i = 0; i < cpp; i++)
+				{
+					const T expected = changed && i == 0 ? T(source[i] + 2) : source[i];
+					if (result[i] != expected)
+						return UnitTestError(MAXON_SOURCE_LOCATION, "Wrong pixel value."_s);
+				}
+			}
+		}
+
+		return OK;
+	}
+
+public:
+	MAXON_METHOD Result<void> Run()
+	{
+		iferr_scope;
+
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareBlocks<UChar>(8, 4);
+			self.AddResult("8 bit"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareBlocks<UInt16>(16, 16);
+			self.AddResult("16 bit"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			const Result<void> res = CompareBlocks<Float32>(32, 5);
+			self.AddResult("32 bit"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			// a single block covers the whole rectangle
+			const Result<void> res = CompareBlocks<Float32>(32, 100);
+			self.AddResult("Single block"_s, res);
+		}
+
+		return OK;
+	}
+};
+
+// ------------------------------------------------------------------------
+/// Registers the unit test at UnitTestClasses.
+// ------------------------------------------------------------------------
+MAXON_COMPONENT_CLASS_REGISTER(VPBlockUnitTest, UnitTestClasses, "net.maxonexample.unittest.vpblock");
+}
@@ -0,0 +1,224 @@
+// local header files
+#include "vpreconstruct_tiles.h"
+
+// Maxon API header files
+#include "maxon/unittest.h"
+#include "maxon/lib_math.h"
+
+namespace maxon
+{
+// ------------------------------------------------------------------------
+/// A fragment with the members ReconstructTiles() reads from a VPFragment.
+// ------------------------------------------------------------------------
+struct SyntheticFragment
+{
+	SyntheticFragment* next;
+	Int32							 weight;
+	Vector32					 color;
+};
+
+// ------------------------------------------------------------------------
+/// An image with random fragments. Some rows have no fragments at all and
+/// some pixels are background pixels without fragments.
+// ------------------------------------------------------------------------
+class SyntheticFragmentImage
+{
+public:
+	Result<void> Init(Int32 width, Int32 height, Int32 cpp, Int32 seed)
+	{
+		iferr_scope;
+
+		_width = width;
+		_height = height;
+		_cpp = cpp;
+
+		cinema::Random rnd;
+		rnd.Init(seed);
+
+		_pixels.Resize(Int(width) * height * cpp) iferr_return;
+		for (Float32& v : _pixels)
+			v = (Float32)rnd.Get01();
+
+		_emptyRow.Resize(height) iferr_return;
+		_heads.Resize(Int(width) * height) iferr_return;
+
+		BaseArray<Int32> counts;
+		counts.Resize(Int(width) * height) iferr_return;
+
+		Int total = 0;
+		for (Int32 y = 0; y < height; y++)
+		{
+			_emptyRow[y] = y % 5 == 3;
+			for (Int32 x = 0; x < width; x++)
+			{
+				const Int32 count = _emptyRow[y] ? 0 : Int32(rnd.Get01() * 5.0);
+				counts[y * width + x] = count;
+				total += count;
+			}
+		}
+
+		// the fragments are linked after the array has its final size
+		_fragments.Resize(total) iferr_return;
+
+		Int index = 0;
+		for (Int i = 0; i < _heads.GetCount(); i++)
+		{
+			SyntheticFragment* prev = nullptr;
+			_heads[i] = nullptr;
+			for (Int32 j = 0; j < counts[i]; j++, index++)
+			{
+				SyntheticFragment& f = _fragments[index];
+				f.next	 = nullptr;
+				f.weight = 1 + Int32(rnd.Get01() * 255.0);
+				f.color	 = Vector32((Float32)rnd.Get01(), (Float32)rnd.Get01(), (Float32)rnd.Get01());
+				if (prev)
+					prev->next = &f;
+				else
+					_heads[i] = &f;
+				prev = &f;
+			}
+		}
+
+		return OK;
+	}
+
+	// source interface of ReconstructTiles()
+	void GetFragments(Int32 y, Int32 rows, const SyntheticFragment*** frag)
+	{
+		for (Int32 i = 0; i < rows; i++)
+			frag[i] = _emptyRow[y + i] ? nullptr : _heads.GetFirst() + Int(y + i) * _width;
+	}
+
+	void FreeFragments(const SyntheticFragment** frag) { }
+	void GetLine(Int32 y, Float32* buffer) const { MemCopy(buffer, _pixels.GetFirst() + Int(y) * _width * _cpp, SIZEOF(Float32) * _width * _cpp); }
+	void SetLine(Int32 y, Float32* buffer) { MemCopy(_pixels.GetFirst() + Int(y) * _width * _cpp, buffer, SIZEOF(Float32) * _width * _cpp); }
+
+	//----------------------------------------------------------------------------------------
+	/// Straightforward single threaded reconstruction, same as the original example.
+	//----------------------------------------------------------------------------------------
+	void Reconstruct()
+	{
+		for (Int32 y = 0; y < _height; y++)
+		{
+			if (_emptyRow[y])
+				continue;
+
+			Float32* b = _pixels.GetFirst() + Int(y) * _width * _cpp;
+			for (Int32 x = 0; x < _width; x++, b += _cpp)
+			{
+				const SyntheticFragment* head = _heads[Int(y) * _width + x];
+				if (!head)
+					continue;
+
+				Vector32 col = Vector32(0.0);
+				for (const SyntheticFragment* f = head; f; f = f->next)
+					col += Float32(f->weight) * f->color;
+
+				col /= (Float32) 256.0;
+				b[0] = col.x;
+				b[1] = col.y;
+				b[2] = col.z;
+			}
+		}
+	}
+
+	Bool IsEqual(const SyntheticFragmentImage& other) const
+	{
+		if (_pixels.GetCount() != other._pixels.GetCount())
+			return false;
+
+		for (Int i = 0; i < _pixels.GetCount(); i++)
+		{
+			if (!CompareFloatTolerant(_pixels[i], other._pixels[i]))
+				return false;
+		}
+		return true;
+	}
+
+private:
+	Int32																_width = 0, _height = 0, _cpp = 0;
+	BaseArray<Float32>									_pixels;
+	BaseArray<SyntheticFragment>				_fragments;
+	BaseArray<const SyntheticFragment*> _heads;
+	BaseArray<Bool>											_emptyRow;
+};
+
+// ------------------------------------------------------------------------
+/// A unit test for the tiled reconstruction of the reconstruct image video post.
+/// Compares the result of ReconstructTiles() with a single threaded reference.
+/// Can be run with command line argument g_runUnitTests=*vpreconstruct*.
+// ------------------------------------------------------------------------
+class VPReconstructUnitTest : public UnitTestComponent<VPReconstructUnitTest>
+{
+	MAXON_COMPONENT();
+
+	//----------------------------------------------------------------------------------------
+	/// Internal utility function to reconstruct a synthetic image with both paths.
+	/// @param[in] width							Width of the image.
+	/// @param[in] height							Height of the image.
+	/// @param[in] cpp								Components per pixel.
+	/// @param[in] rowsPerTile				Number of rows per tile.
+	/// @param[in] frames							Number of frames with different fragments, reconstructed with the same arenas.
+	/// @return												OK if all results are equal.
+	//----------------------------------------------------------------------------------------
+	Result<void> CompareReconstruction(Int32 width, Int32 height, Int32 cpp, Int32 rowsPerTile, Int32 frames)
+	{
+		iferr_scope;
+
+		BaseArray<FragmentArena<SyntheticFragment>> arenas;
+
+		for (Int32 frame = 0; frame < frames; frame++)
+		{
+			SyntheticFragmentImage image, reference;
+			image.Init(width, height, cpp, frame + 1) iferr_return;
+			reference.Init(width, height, cpp, frame + 1) iferr_return;
+
+			reference.Reconstruct();
+			ReconstructTiles(image, 0, height - 1, width, cpp, rowsPerTile, arenas, nullptr) iferr_return;
+
+			if (!image.IsEqual(reference))
+				return UnitTestError(MAXON_SOURCE_LOCATION, "Reconstruction does not match."_s);
+		}
+
+		return OK;
+	}
+
+public:
+	MAXON_METHOD Result<void> Run()
+	{
+		iferr_scope;
+
+		MAXON_SCOPE
+		{
+			// every row is a tile
+			const Result<void> res = CompareReconstruction(64, 40, 4, 1, 1);
+			self.AddResult("Single rows"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			// the last tile is not complete
+			const Result<void> res = CompareReconstruction(100, 53, 4, 16, 1);
+			self.AddResult("Partial tile"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			// one tile for the whole image, rgb lines
+			const Result<void> res = CompareReconstruction(31, 7, 3, 64, 1);
+			self.AddResult("Single tile"_s, res);
+		}
+		MAXON_SCOPE
+		{
+			// the arenas of the first frame are reused for the following frames
+			const Result<void> res = CompareReconstruction(200, 120, 4, 16, 3);
+			self.AddResult("Frame sequence"_s, res);
+		}
+
+		return OK;
+	}
+};
+
+// ------------------------------------------------------------------------
+/// Registers the unit test at UnitTestClasses.
+// ------------------------------------------------------------------------
+MAXON_COMPONENT_CLASS_REGISTER(VPReconstructUnitTest, UnitTestClasses, "net.maxonexample.unittest.vpreconstruct");
+}
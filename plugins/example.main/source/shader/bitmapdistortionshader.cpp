@@ -1,18 +1,42 @@
 // example for a channel shader with access to basechannel
 // using standard GUI elements
 
+#include "maxon/parallelfor.h"
 #include "c4d.h"
 #include "c4d_symbols.h"
 #include "main.h"
+#include "shaderids.h"
 #include "xbitmapdistortion.h"
 
+// resolution range of the cached distortion field in UV space
+#define DISTORTION_FIELD_MINRES	64
+#define DISTORTION_FIELD_MAXRES	2048
+
+// grid points per period of the finest turbulence octave, below that the bilinear lookup visibly smooths the noise
+#define DISTORTION_FIELD_SAMPLES	4
+
 using namespace cinema;
 
+// turbulence of the distortion for UV [0..1] with z = 0, two values per grid point, (res + 1)^2 points.
+// The field is baked in InitRender and freed in FreeRender.
+struct DistortionField
+{
+	Int32											res = 0;
+	maxon::BaseArray<Float32> data;
+
+	void Reset()
+	{
+		res = 0;
+		data.Reset();
+	}
+};
+
 class BitmapData : public ShaderData
 {
 public:
 	Float				noise, scale, octaves;
 	BaseShader* shader;
+	DistortionField field;
 
 public:
 	virtual Bool Init		(GeListNode* node, Bool isCloneInit);
@@ -27,6 +51,10 @@ public:
 	virtual BaseShader*	GetSubsurfaceShader(BaseShader* sh, Float& bestmpl);
 
 	static NodeData* Alloc() { return NewObjClear(BitmapData); }
+
+private:
+	maxon::Result<void> BakeField(Int32 r);
+	Vector Distort(const Vector& uv) const;
 };
 
 SHADERINFO BitmapData::GetRenderInfo(BaseShader* sh)
@@ -53,6 +81,7 @@ Bool BitmapData::Init(GeListNode* node, Bool isCloneInit)
 		data->SetFloat(BITMAPDISTORTIONSHADER_OCTAVES, 1.0);
 		data->SetFloat(BITMAPDISTORTIONSHADER_SCALE, 1.0);
 		data->SetLink(BITMAPDISTORTIONSHADER_TEXTURE, nullptr);
+		data->SetBool(BITMAPDISTORTIONSHADER_CACHE, false);
 	}
 
 	return true;
@@ -69,6 +98,35 @@ Bool BitmapData::Read(GeListNode* node, HyperFile* hf, Int32 level)
 	return true;
 }
 
+Vector BitmapData::Distort(const Vector& uv) const
+{
+	if (noise <= 0.0)
+		return uv;
+
+	Vector res;
+
+	if (field.res > 0 && uv.z == 0.0 && uv.x >= 0.0 && uv.x <= 1.0 && uv.y >= 0.0 && uv.y <= 1.0)
+	{
+		// bilinear lookup
+		const Int32		 r	= field.res;
+		const Int			 n	= r + 1;
+		const Float		 fx = uv.x * r, fy = uv.y * r;
+		const Int32		 x	= Min((Int32)fx, r - 1), y = Min((Int32)fy, r - 1);
+		const Float		 tx = fx - x, ty = fy - y;
+		const Float32* c	= field.data.GetFirst() + (y * n + x) * 2;
+
+		res.x = Blend(Blend(Float(c[0]), Float(c[2]), tx), Blend(Float(c[n * 2]), Float(c[n * 2 + 2]), tx), ty);
+		res.y = Blend(Blend(Float(c[1]), Float(c[3]), tx), Blend(Float(c[n * 2 + 1]), Float(c[n * 2 + 3]), tx), ty);
+	}
+	else
+	{
+		Float scl = 60.0 * scale;
+		res = Vector(Turbulence(uv * scl, octaves, true), Turbulence((uv + Vector(0.34, 13.0, 2.43)) * scl, octaves, true), 0.0);
+	}
+
+	return Vector(Blend(uv.x, res.x, noise), Blend(uv.y, res.y, noise), uv.z);
+}
+
 Vector BitmapData::Output(BaseShader* chn, ChannelData* cd)
 {
 	if (!shader)
@@ -76,20 +134,61 @@ Vector BitmapData::Output(BaseShader* chn, ChannelData* cd)
 
 	Vector uv = cd->p;
 
-	if (noise > 0.0)
-	{
-		Float	 scl = 60.0 * scale;
-		Vector res = Vector(Turbulence(uv * scl, octaves, true), Turbulence((uv + Vector(0.34, 13.0, 2.43)) * scl, octaves, true), 0.0);
-		cd->p.x = Blend(uv.x, res.x, noise);
-		cd->p.y = Blend(uv.y, res.y, noise);
-	}
-
+	cd->p = Distort(uv);
 	Vector res = shader->Sample(cd);
 	cd->p = uv;
 
 	return res;
 }
 
+// returns the field resolution needed for the current scale and octaves or 0 if the field
+// would undersample the turbulence, in that case the distortion is evaluated directly
+static Int32 GetFieldResolution(Float scale, Float octaves)
+{
+	// the base frequency is 60 * scale periods per UV unit, every further octave doubles it
+	Float freq = 60.0 * Abs(scale);
+	for (Float o = 1.0; o < octaves; o += 1.0)
+		freq *= 2.0;
+
+	const Float needed = freq * DISTORTION_FIELD_SAMPLES;
+	if (needed > DISTORTION_FIELD_MAXRES)
+		return 0;
+
+	Int32 res = DISTORTION_FIELD_MINRES;
+	while (res < needed)
+		res *= 2;
+
+	return res;
+}
+
+maxon::Result<void> BitmapData::BakeField(Int32 r)
+{
+	iferr_scope;
+
+	const Int n = r + 1;
+
+	field.res = 0;
+	field.data.Resize(n * n * 2) iferr_return;
+
+	const Float scl = 60.0 * scale;
+	maxon::ParallelFor::Dynamic(0, n,
+		[this, n, r, scl](Int y)
+		{
+			Float32* dst = field.data.GetFirst() + y * n * 2;
+
+			for (Int x = 0; x < n; x++)
+			{
+				const Vector uv(Float(x) / r, Float(y) / r, 0.0);
+				*dst++ = (Float32)Turbulence(uv * scl, octaves, true);
+				*dst++ = (Float32)Turbulence((uv + Vector(0.34, 13.0, 2.43)) * scl, octaves, true);
+			}
+		});
+
+	field.res = r;
+
+	return maxon::OK;
+}
+
 INITRENDERRESULT BitmapData::InitRender(BaseShader* chn, const InitRenderStruct& irs)
 {
 	BaseContainer* data = chn->GetDataInstance();
@@ -99,6 +198,18 @@ INITRENDERRESULT BitmapData::InitRender(BaseShader* chn, const InitRenderStruct&
 	octaves = data->GetFloat(BITMAPDISTORTIONSHADER_OCTAVES);
 	scale	 = data->GetFloat(BITMAPDISTORTIONSHADER_SCALE);
 	shader = (BaseShader*)data->GetLink(BITMAPDISTORTIONSHADER_TEXTURE, irs.doc, Xbase);
+
+	field.Reset();
+	const Int32 fieldRes = GetFieldResolution(scale, octaves);
+	if (noise > 0.0 && fieldRes > 0 && data->GetBool(BITMAPDISTORTIONSHADER_CACHE))
+	{
+		iferr (BakeField(fieldRes))
+		{
+			field.Reset();
+			return INITRENDERRESULT::OUTOFMEMORY;
+		}
+	}
+
 	if (shader)
 		return shader->InitRender(irs);
 
@@ -110,6 +221,7 @@ void BitmapData::FreeRender(BaseShader* chn)
 	if (shader)
 		shader->FreeRender();
 	shader = nullptr;
+	field.Reset();
 }
 
 Bool BitmapData::Message(GeListNode* node, Int32 type, void* msgdat)
@@ -122,9 +234,6 @@ Bool BitmapData::Message(GeListNode* node, Int32 type, void* msgdat)
 	return true;
 }
 
-// be sure to use a unique ID obtained from www.plugincafe.com
-#define ID_BITMAPDISTORTION 1001160
-
 Bool RegisterBitmap()
 {
 	return RegisterShaderPlugin(ID_BITMAPDISTORTION, GeLoadString(IDS_BITMAPDISTORTION), 0, BitmapData::Alloc, "Xbitmapdistortion"_s, 0);
@@ -1,9 +1,15 @@
 // example for a complex channel shader with custom areas
 // and animated preview
+#include "maxon/parallelfor.h"
 #include "c4d.h"
 #include "c4d_symbols.h"
 #include "xsdkgradient.h"
 #include "main.h"
+#include "shaderids.h"
+
+// minimum resolution of the turbulence lattice and lattice points per period of the finest octave
+#define GRADIENT_LATTICE_MINRES		64
+#define GRADIENT_LATTICE_SAMPLES	4
 
 using namespace cinema;
 
@@ -18,6 +24,11 @@ struct GradientData
 	Float			turbulence, octaves, scale, freq;
 	Bool			absolute;
 
+	// baked turbulence for the UV square at z = 0, two values per lattice point, (latticeRes + 1)^2 points
+	Int32			latticeRes;
+	Float			latticeTime;
+	maxon::BaseArray<Float32> lattice;
+
 	maxon::GradientRenderData gradientRenderData;
 };
 
@@ -33,8 +44,34 @@ public:
 	virtual	void FreeRender(BaseShader* sh);
 
 	static NodeData* Alloc() { return NewObjClear(SDKGradientClass); }
+
+private:
+	maxon::Result<void> BakeLattice(Int32 res, Float time);
+	Bool SampleLattice(const Vector& p, Float time, Vector& res) const;
 };
 
+// returns the resolution of a lattice that samples every octave of the turbulence with
+// GRADIENT_LATTICE_SAMPLES points per period, or 0 if such a lattice doesn't fit into the budget
+static Int32 GetLatticeResolution(Float scale, Float octaves, Float budget)
+{
+	// the base frequency is 5 * scale periods per unit, every further octave doubles it
+	Float freq = 5.0 * Abs(scale);
+	for (Float o = 1.0; o < octaves; o += 1.0)
+		freq *= 2.0;
+
+	const Float needed = freq * GRADIENT_LATTICE_SAMPLES;
+	Int32				res = GRADIENT_LATTICE_MINRES;
+	for (;;)
+	{
+		const Float n = Float(res) + 1.0;
+		if (n * n * 2.0 * sizeof(Float32) > budget)
+			return 0;
+		if (res >= needed)
+			return res;
+		res *= 2;
+	}
+}
+
 Bool SDKGradientClass::Init(GeListNode* node, Bool isCloneInit)
 {
 	BaseContainer* data = static_cast<BaseShader*>(node)->GetDataInstance();
@@ -65,6 +102,8 @@ Bool SDKGradientClass::Init(GeListNode* node, Bool isCloneInit)
 		data->SetFloat(SDKGRADIENTSHADER_SCALE, 1.0);
 		data->SetFloat(SDKGRADIENTSHADER_FREQ, 1.0);
 		data->SetBool(SDKGRADIENTSHADER_ABSOLUTE, false);
+		data->SetBool(SDKGRADIENTSHADER_LATTICE, false);
+		data->SetInt32(SDKGRADIENTSHADER_LATTICE_MEMORY, 16);
 	}
 
 	return true;
@@ -105,12 +144,87 @@ INITRENDERRESULT SDKGradientClass::InitRender(BaseShader* sh, const InitRenderSt
 			gdata.c[i] = Vector(k->col);
 	}
 
+	gdata.latticeRes = 0;
+	gdata.lattice.Reset();
+	if (gdata.turbulence > 0.0 && dat->GetBool(SDKGRADIENTSHADER_LATTICE))
+	{
+		// a lattice that undersamples the finer octaves would change the result, in that case
+		// all points are evaluated directly
+		const Float budget = Float(ClampValue(dat->GetInt32(SDKGRADIENTSHADER_LATTICE_MEMORY), (Int32)1, (Int32)1024)) * 1024.0 * 1024.0;
+		const Int32 res		 = GetLatticeResolution(gdata.scale, gdata.octaves, budget);
+
+		if (res > 0)
+		{
+			iferr (BakeLattice(res, irs.time.Get()))
+			{
+				gdata.latticeRes = 0;
+				gdata.lattice.Reset();
+				return INITRENDERRESULT::OUTOFMEMORY;
+			}
+		}
+	}
+
 	return INITRENDERRESULT::OK;
 }
 
 void SDKGradientClass::FreeRender(BaseShader* sh)
 {
 	gdata.gradientRenderData = nullptr;
+	gdata.latticeRes = 0;
+	gdata.lattice.Reset();
+}
+
+maxon::Result<void> SDKGradientClass::BakeLattice(Int32 res, Float time)
+{
+	iferr_scope;
+
+	const Int n = res + 1;
+	gdata.lattice.Resize(n * n * 2) iferr_return;
+	gdata.latticeRes = res;
+	gdata.latticeTime = time;
+
+	// same evaluation as in Output, one row of lattice points per job
+	const Float scl = 5.0 * gdata.scale, tt = time * gdata.freq * 0.3;
+	maxon::ParallelFor::Dynamic(0, n,
+		[this, n, res, scl, tt](Int y)
+		{
+			Float32* dst = gdata.lattice.GetFirst() + y * n * 2;
+
+			for (Int x = 0; x < n; x++)
+			{
+				const Vector p(Float(x) / res, Float(y) / res, 0.0);
+				*dst++ = (Float32)Turbulence(p * scl, tt, gdata.octaves, true);
+				*dst++ = (Float32)Turbulence((p + Vector(0.34, 13.0, 2.43)) * scl, tt, gdata.octaves, true);
+			}
+		});
+
+	return maxon::OK;
+}
+
+Bool SDKGradientClass::SampleLattice(const Vector& p, Float time, Vector& res) const
+{
+	// points outside of the UV square, 3D points or points at a different time (motion blur) are evaluated directly
+	if (gdata.latticeRes <= 0 || time != gdata.latticeTime)
+		return false;
+	if (p.x < 0.0 || p.x > 1.0 || p.y < 0.0 || p.y > 1.0 || p.z != 0.0)
+		return false;
+
+	const Int32 r = gdata.latticeRes;
+	const Int		n = r + 1;
+	const Float fx = p.x * r, fy = p.y * r;
+	const Int32 x = Min((Int32)fx, r - 1), y = Min((Int32)fy, r - 1);
+	const Float tx = fx - x, ty = fy - y;
+
+	const Float32* c = gdata.lattice.GetFirst() + (y * n + x) * 2;
+	const Int			 dy = n * 2;
+	Float					 v[2];
+
+	// bilinear interpolation of both channels
+	for (Int i = 0; i < 2; i++)
+		v[i] = Blend(Blend(Float(c[i]), Float(c[i + 2]), tx), Blend(Float(c[i + dy]), Float(c[i + dy + 2]), tx), ty);
+
+	res = Vector(v[0], v[1], 0.0);
+	return true;
 }
 
 Vector SDKGradientClass::Output(BaseShader* sh, ChannelData* sd)
@@ -121,9 +235,13 @@ Vector SDKGradientClass::Output(BaseShader* sh, ChannelData* sd)
 	if (gdata.turbulence > 0.0)
 	{
 		Vector res;
-		Float	 scl = 5.0 * gdata.scale, tt = sd->t * gdata.freq * 0.3;
 
-		res = Vector(Turbulence(p * scl, tt, gdata.octaves, true), Turbulence((p + Vector(0.34, 13.0, 2.43)) * scl, tt, gdata.octaves, true), 0.0);
+		if (!SampleLattice(p, sd->t, res))
+		{
+			Float scl = 5.0 * gdata.scale, tt = sd->t * gdata.freq * 0.3;
+
+			res = Vector(Turbulence(p * scl, tt, gdata.octaves, true), Turbulence((p + Vector(0.34, 13.0, 2.43)) * scl, tt, gdata.octaves, true), 0.0);
+		}
 
 		if (gdata.absolute)
 		{
@@ -246,5 +364,5 @@ Bool RegisterGradient()
 	RegisterIcon(200000142, bmp, 7 * 32, 0, 32, 32, ICONFLAG::COPY);
 
 	// be sure to use a unique ID obtained from www.plugincafe.com
-	return RegisterShaderPlugin(1001161, GeLoadString(IDS_SDKGRADIENT), 0, SDKGradientClass::Alloc, "Xsdkgradient"_s, 0);
+	return RegisterShaderPlugin(ID_SDKGRADIENT, GeLoadString(IDS_SDKGRADIENT), 0, SDKGradientClass::Alloc, "Xsdkgradient"_s, 0);
 }
@@ -1,20 +1,61 @@
 // example for an easy implementation of a channel shader
 
+#include "maxon/parallelfor.h"
 #include "c4d.h"
 #include "c4d_symbols.h"
 #include "main.h"
+#include "shaderids.h"
 #include "xmandelbrot.h"
 
 #define CCOUNT 125
 
+// escape radius and iteration depth of the fractal
+#define MANDELBROT_BORDER 5.0
+#define MANDELBROT_DEPTH	50
+
+// number of points iterated together by CalcpixBatch. The lane loops are written without
+// data dependent branches so that the compiler can map them onto SSE/AVX2/NEON registers.
+#define MANDELBROT_LANES	8
+
+// the baked field is stored in square tiles of MANDELBROT_TILE texels, one tile row is one CalcpixBatch call
+#define MANDELBROT_TILE					8
+#define MANDELBROT_FIELD_MINRES	256
+#define MANDELBROT_FIELD_MAXRES	2048
+
 using namespace cinema;
 
+// escape-count field of the fractal in UV space [0..1], baked in InitRender.
+// Level 0 holds the iteration counts, the coarser levels hold the box filtered colors.
+struct MandelbrotField
+{
+	Int32												res = 0;		// resolution of level 0
+	Int32												levels = 0;	// number of levels including level 0
+	maxon::BaseArray<UChar>			counts;			// level 0, tiled
+	maxon::BaseArray<Vector32>	mips;				// levels 1..levels-1, tiled
+	maxon::BaseArray<Int>				mipOffset;	// start of each level in mips (index 0 unused)
+
+	static Int TiledIndex(Int32 x, Int32 y, Int32 levelRes)
+	{
+		const Int tilesPerRow = levelRes / MANDELBROT_TILE;
+		return ((y / MANDELBROT_TILE) * tilesPerRow + (x / MANDELBROT_TILE)) * (MANDELBROT_TILE * MANDELBROT_TILE) + (y % MANDELBROT_TILE) * MANDELBROT_TILE + (x % MANDELBROT_TILE);
+	}
+
+	void Reset()
+	{
+		res = levels = 0;
+		counts.Reset();
+		mips.Reset();
+		mipOffset.Reset();
+	}
+};
+
 class MandelbrotData : public ShaderData
 {
 public:
 	Int32		offset;
 	Bool		object_access;
 	Vector* colors;
+	MandelbrotField field;
 
 public:
 	virtual Bool	 Init(GeListNode* node, Bool isCloneInit);
@@ -23,6 +64,13 @@ public:
 	virtual	INITRENDERRESULT InitRender(BaseShader* sh, const InitRenderStruct& irs);
 	virtual	void FreeRender(BaseShader* sh);
 
+private:
+	maxon::Result<void> BakeField(Int32 res);
+	Vector FieldTexel(Int32 level, Int32 x, Int32 y) const;
+	Vector SampleFieldLevel(Int32 level, Float u, Float v) const;
+	Vector SampleField(const Vector& p, const Vector& delta) const;
+
+public:
 	static NodeData* Alloc() { return NewObjClear(MandelbrotData); }
 };
 
@@ -67,12 +115,34 @@ INITRENDERRESULT MandelbrotData::InitRender(BaseShader* sh, const InitRenderStru
 	offset = data->GetInt32(MANDELBROTSHADER_COLOROFFSET);
 	object_access = data->GetBool(MANDELBROTSHADER_OBJECTACCESS);
 
+	field.Reset();
+	if (data->GetBool(MANDELBROTSHADER_BAKE))
+	{
+		// the field resolution follows the render size, rounded up to a power of two
+		Int32				res = MANDELBROT_FIELD_MINRES;
+		RenderData* rd	= irs.doc ? irs.doc->GetActiveRenderData() : nullptr;
+		if (rd)
+		{
+			const BaseContainer& rdata = rd->GetDataInstanceRef();
+			const Float					 size	 = FMax(rdata.GetFloat(RDATA_XRES), rdata.GetFloat(RDATA_YRES));
+			while (res < MANDELBROT_FIELD_MAXRES && res < size)
+				res *= 2;
+		}
+
+		iferr (BakeField(res))
+		{
+			field.Reset();
+			return INITRENDERRESULT::OUTOFMEMORY;
+		}
+	}
+
 	return INITRENDERRESULT::OK;
 }
 
 void MandelbrotData::FreeRender(BaseShader* sh)
 {
 	DeleteMem(colors);
+	field.Reset();
 }
 
 static Int32 Calcpix(Float r_min, Float i_min, Float border, Int32 depth)
@@ -97,13 +167,190 @@ static Int32 Calcpix(Float r_min, Float i_min, Float border, Int32 depth)
 	return z;
 }
 
+// batched version of Calcpix for MANDELBROT_LANES points.
+// Every lane carries an active mask that is cleared once the point escapes, the loop
+// terminates as soon as all lanes have escaped. result receives the same values as Calcpix.
+static void CalcpixBatch(const Float* r_min, const Float* i_min, Float border, Int32 depth, Int32* result)
+{
+	Float rz[MANDELBROT_LANES], iz[MANDELBROT_LANES];
+	Int32 active[MANDELBROT_LANES];
+	Int32 l, z;
+
+	for (l = 0; l < MANDELBROT_LANES; l++)
+	{
+		rz[l] = r_min[l];
+		iz[l] = i_min[l];
+		active[l] = 1;
+		result[l] = 0;
+	}
+
+	for (z = 0; z < depth; z++)
+	{
+		Int32 alive = 0;
+
+		for (l = 0; l < MANDELBROT_LANES; l++)
+		{
+			Float iq = iz[l] * iz[l];
+			Float rq = rz[l] * rz[l];
+
+			active[l] &= (rq + iq) <= border ? 1 : 0;
+			result[l] += active[l];
+			alive |= active[l];
+
+			// escaped lanes keep their last value
+			Float ni = ((rz[l] * iz[l]) * 2.0) + i_min[l];
+			Float nr = rq - iq + r_min[l];
+			iz[l] = active[l] ? ni : iz[l];
+			rz[l] = active[l] ? nr : rz[l];
+		}
+
+		if (!alive)
+			break;
+	}
+}
+
+maxon::Result<void> MandelbrotData::BakeField(Int32 res)
+{
+	iferr_scope;
+
+	Int32 levels = 1, levelRes;
+	for (levelRes = res; levelRes > MANDELBROT_TILE; levelRes /= 2)
+		levels++;
+
+	field.mipOffset.Resize(levels) iferr_return;
+	Int mipCount = 0;
+	for (Int32 l = 1; l < levels; l++)
+	{
+		field.mipOffset[l] = mipCount;
+		mipCount += Int(res >> l) * Int(res >> l);
+	}
+
+	field.counts.Resize(Int(res) * Int(res)) iferr_return;
+	field.mips.Resize(mipCount) iferr_return;
+	field.res = res;
+	field.levels = levels;
+
+	// level 0, one tile row per job, MANDELBROT_TILE texels per batch
+	const Float inv = 1.0 / res;
+	maxon::ParallelFor::Dynamic(0, res,
+		[this, res, inv](Int y)
+		{
+			Float px[MANDELBROT_LANES], py[MANDELBROT_LANES];
+			Int32 it[MANDELBROT_LANES];
+
+			for (Int32 x = 0; x < res; x += MANDELBROT_LANES)
+			{
+				for (Int32 l = 0; l < MANDELBROT_LANES; l++)
+				{
+					px[l] = ((x + l + 0.5) * inv * 4.5) - 2.5;
+					py[l] = ((y + 0.5) * inv * 3.0) - 1.5;
+				}
+
+				CalcpixBatch(px, py, MANDELBROT_BORDER, MANDELBROT_DEPTH, it);
+
+				for (Int32 l = 0; l < MANDELBROT_LANES; l++)
+					field.counts[MandelbrotField::TiledIndex(x + l, (Int32)y, res)] = (UChar)it[l];
+			}
+		});
+
+	// coarser levels, each texel is the average color of four texels of the finer level
+	for (Int32 level = 1; level < levels; level++)
+	{
+		const Int32 lres = res >> level;
+		maxon::ParallelFor::Dynamic(0, lres,
+			[this, level, lres](Int y)
+			{
+				for (Int32 x = 0; x < lres; x++)
+				{
+					Vector sum = FieldTexel(level - 1, 2 * x, 2 * (Int32)y) + FieldTexel(level - 1, 2 * x + 1, 2 * (Int32)y) +
+											 FieldTexel(level - 1, 2 * x, 2 * (Int32)y + 1) + FieldTexel(level - 1, 2 * x + 1, 2 * (Int32)y + 1);
+					field.mips[field.mipOffset[level] + MandelbrotField::TiledIndex(x, (Int32)y, lres)] = Vector32(sum * 0.25);
+				}
+			});
+	}
+
+	return maxon::OK;
+}
+
+Vector MandelbrotData::FieldTexel(Int32 level, Int32 x, Int32 y) const
+{
+	if (level == 0)
+		return colors[(field.counts[MandelbrotField::TiledIndex(x, y, field.res)] + offset) % CCOUNT];
+
+	return Vector(field.mips[field.mipOffset[level] + MandelbrotField::TiledIndex(x, y, field.res >> level)]);
+}
+
+Vector MandelbrotData::SampleFieldLevel(Int32 level, Float u, Float v) const
+{
+	// bilinear filter, texel centers are at half integer positions
+	const Int32 lres = field.res >> level;
+	const Float fx = u * lres - 0.5, fy = v * lres - 0.5;
+	Int32				x0 = (Int32)Floor(fx), y0 = (Int32)Floor(fy);
+	const Float tx = fx - x0, ty = fy - y0;
+	Int32				x1 = x0 + 1, y1 = y0 + 1;
+
+	x0 = ClampValue(x0, (Int32)0, lres - 1);
+	x1 = ClampValue(x1, (Int32)0, lres - 1);
+	y0 = ClampValue(y0, (Int32)0, lres - 1);
+	y1 = ClampValue(y1, (Int32)0, lres - 1);
+
+	const Vector a = Blend(FieldTexel(level, x0, y0), FieldTexel(level, x1, y0), tx);
+	const Vector b = Blend(FieldTexel(level, x0, y1), FieldTexel(level, x1, y1), tx);
+	return Blend(a, b, ty);
+}
+
+Vector MandelbrotData::SampleField(const Vector& p, const Vector& delta) const
+{
+	// choose the level from the MIP footprint, blend between the two nearest levels
+	const Float footprint = FMax(Abs(delta.x), Abs(delta.y)) * field.res;
+	const Float lod = footprint > 1.0 ? FMin(Log2(footprint), Float(field.levels - 1)) : 0.0;
+	const Int32 level = (Int32)lod;
+
+	const Vector col = SampleFieldLevel(level, p.x, p.y);
+	if (level + 1 >= field.levels || lod <= level)
+		return col;
+
+	return Blend(col, SampleFieldLevel(level + 1, p.x, p.y), lod - level);
+}
+
 Vector MandelbrotData::Output(BaseShader* chn, ChannelData* cd)
 {
-	Float px = (cd->p.x * 4.5) - 2.5;
-	Float py = (cd->p.y * 3.0) - 1.5;
+	Vector col;
 
-	Int32	 i = Calcpix(px, py, 5.0, 50);
-	Vector col = colors[(i + offset) % CCOUNT];
+	if (field.levels > 0 && cd->p.x >= 0.0 && cd->p.x <= 1.0 && cd->p.y >= 0.0 && cd->p.y <= 1.0)
+	{
+		col = SampleField(cd->p, cd->d);
+	}
+	else if (cd->d.x != 0.0 || cd->d.y != 0.0)
+	{
+		// the footprint of the sample is box filtered like the levels of the baked field,
+		// MANDELBROT_LANES points of a rotated grid are iterated in one batch
+		Float px[MANDELBROT_LANES], py[MANDELBROT_LANES];
+		Int32 it[MANDELBROT_LANES];
+
+		for (Int32 l = 0; l < MANDELBROT_LANES; l++)
+		{
+			const Float sx = (l + 0.5) / MANDELBROT_LANES - 0.5;
+			const Float sy = ((l * 3) % MANDELBROT_LANES + 0.5) / MANDELBROT_LANES - 0.5;
+			px[l] = ((cd->p.x + sx * cd->d.x) * 4.5) - 2.5;
+			py[l] = ((cd->p.y + sy * cd->d.y) * 3.0) - 1.5;
+		}
+
+		CalcpixBatch(px, py, MANDELBROT_BORDER, MANDELBROT_DEPTH, it);
+
+		col = Vector(0.0);
+		for (Int32 l = 0; l < MANDELBROT_LANES; l++)
+			col += colors[(it[l] + offset) % CCOUNT];
+		col *= 1.0 / MANDELBROT_LANES;
+	}
+	else
+	{
+		Float px = (cd->p.x * 4.5) - 2.5;
+		Float py = (cd->p.y * 3.0) - 1.5;
+
+		Int32 i = Calcpix(px, py, MANDELBROT_BORDER, MANDELBROT_DEPTH);
+		col = colors[(i + offset) % CCOUNT];
+	}
 
 	if (cd->vd && object_access)
 	{
@@ -121,9 +368,6 @@ Vector MandelbrotData::Output(BaseShader* chn, ChannelData* cd)
 	return col;
 }
 
-// be sure to use a unique ID obtained from www.plugincafe.com
-#define ID_MANDELBROT	1001162
-
 Bool RegisterMandelbrot()
 {
 	return RegisterShaderPlugin(ID_MANDELBROT, GeLoadString(IDS_MANDELBROT), 0, MandelbrotData::Alloc, "Xmandelbrot"_s, 0);
@@ -1,20 +1,29 @@
 // volumetric shader example that accesses particles and displays its own preview
-// absolutely not optimized for speed
+// coverage queries are accelerated by a bounding volume hierarchy, see particlevolume_bvh.h
 
+#include "maxon/parallelfor.h"
 #include "c4d.h"
 #include "c4d_symbols.h"
 #include "customgui_matpreview.h"
 #include "main.h"
+#include "particlevolume_bvh.h"
 
 using namespace cinema;
 
-struct PVRender
+// coverage of the last ray segment evaluated on a render cpu.
+// CalcVolumetric and CalcTransparency are called for the same segment, the second call reuses the result.
+struct PVRayCache
 {
-	PVRender();
-	~PVRender();
+	Bool	 valid = false;
+	Vector p, v;
+	Float	 dist = 0.0;
+	Float	 coverage = 0.0;
+};
 
-	Vector* mp;
-	Int32		count;
+struct PVRender
+{
+	ParticleBVH										bvh;
+	maxon::BaseArray<PVRayCache>	rayCache;	// one entry per render cpu, indexed by VolumeData::GetCurrentCpu()
 };
 
 class ParticleVolume : public MaterialData
@@ -52,117 +61,134 @@ VOLUMEINFO ParticleVolume::GetRenderInfo(BaseMaterial* mat)
 }
 
 #define MAX_PARTICLES 10000
+#define PT_RADIUS 50.0
 
-PVRender::PVRender()
+// a particle emitter of the scene and the range of its particles in the gathered buffer
+struct PVEmitter
 {
-	mp = nullptr;
-	count = 0;
-}
+	ParticleObject* po;
+	ParticleTag*		pt;
+	Int							first;
+	Int							count;
+};
 
-PVRender::~PVRender()
+static Bool IsRenderedParticle(const Particle* pp)
 {
-	DeleteMem(mp);
+	return (pp->bits & (PARTICLEFLAGS::VISIBLE | PARTICLEFLAGS::ALIVE)) == (PARTICLEFLAGS::VISIBLE | PARTICLEFLAGS::ALIVE);
 }
 
-static Bool FillPV(PVRender* pv, BaseObject* op)
+static maxon::Result<void> CollectEmitters(maxon::BaseArray<PVEmitter>& emitters, BaseObject* op)
 {
+	iferr_scope;
+
 	while (op)
 	{
 		if (op->GetType() == Oparticle && !op->GetDown() && op->GetDeformMode())	// particle system without geometry
 		{
-			ParticleObject* po = (ParticleObject*)op;
-			ParticleTag*		pt = (ParticleTag*)op->GetTag(Tparticle);
+			ParticleTag* pt = (ParticleTag*)op->GetTag(Tparticle);
 			if (pt)
 			{
-				Vector*					mp = nullptr;
-				const Particle* pp = nullptr;
-				Int32 pcnt = po->GetParticleCount(), rcnt = 0, i;
-
-				for (i = 0; i < pcnt; i++)
-				{
-					pp = po->GetParticleR(pt, i);
-					if (pp->bits & (PARTICLEFLAGS::VISIBLE | PARTICLEFLAGS::ALIVE))
-						rcnt++;
-				}
-
-				if (pv->count + rcnt > 0)
-				{
-					iferr (mp = NewMemClear(Vector, pv->count + rcnt))
-						return false;
-
-					CopyMemType(pv->mp, mp, pv->count);
-					DeleteMem(pv->mp);
-					pv->mp = mp;
-
-					for (i = 0; i < pcnt; i++)
-					{
-						pp = po->GetParticleR(pt, i);
-						if ((pp->bits & (PARTICLEFLAGS::VISIBLE | PARTICLEFLAGS::ALIVE)) == (PARTICLEFLAGS::VISIBLE | PARTICLEFLAGS::ALIVE))
-							mp[pv->count++] = pp->off;
-					}
-				}
+				PVEmitter& emitter = emitters.Append() iferr_return;
+				emitter.po = (ParticleObject*)op;
+				emitter.pt = pt;
+				emitter.first = 0;
+				emitter.count = 0;
 			}
 		}
 
-		if (!FillPV(pv, op->GetDown()))
-			return false;
+		CollectEmitters(emitters, op->GetDown()) iferr_return;
 		op = op->GetNext();
 	}
-	return true;
+
+	return maxon::OK;
 }
 
-INITRENDERRESULT ParticleVolume::InitRender(BaseMaterial* mat, const InitRenderStruct& irs)
+// gathers the particles of all emitters in two passes: the first one counts the rendered particles
+// of each emitter, the second one fills them into one contiguous buffer. Both passes run in parallel across emitters.
+static maxon::Result<void> FillPV(ParticleSpheres& spheres, BaseDocument* doc)
 {
-	render = NewObjClear(PVRender);
-	if (!render)
-		return INITRENDERRESULT::OUTOFMEMORY;
+	iferr_scope;
 
-	if (irs.doc && !FillPV(render, irs.doc->GetFirstObject()))
+	maxon::BaseArray<PVEmitter> emitters;
+	CollectEmitters(emitters, doc->GetFirstObject()) iferr_return;
+
+	maxon::ParallelFor::Dynamic(0, emitters.GetCount(),
+		[&emitters](Int e)
+		{
+			PVEmitter&	emitter = emitters[e];
+			const Int32 pcnt = emitter.po->GetParticleCount();
+
+			for (Int32 i = 0; i < pcnt; i++)
+			{
+				if (IsRenderedParticle(emitter.po->GetParticleR(emitter.pt, i)))
+					emitter.count++;
+			}
+		});
+
+	Int total = 0;
+	for (PVEmitter& emitter : emitters)
 	{
-		DeleteObj(render);
-		return INITRENDERRESULT::OUTOFMEMORY;
+		emitter.first = total;
+		total += emitter.count;
 	}
 
-	return INITRENDERRESULT::OK;
-}
+	spheres.Resize(total) iferr_return;
 
-void ParticleVolume::FreeRender(BaseMaterial* mat)
-{
-	DeleteObj(render);
+	maxon::ParallelFor::Dynamic(0, emitters.GetCount(),
+		[&emitters, &spheres](Int e)
+		{
+			const PVEmitter& emitter = emitters[e];
+			const Int32			 pcnt = emitter.po->GetParticleCount();
+			Int							 index = emitter.first;
+
+			for (Int32 i = 0; i < pcnt; i++)
+			{
+				const Particle* pp = emitter.po->GetParticleR(emitter.pt, i);
+				if (IsRenderedParticle(pp))
+					spheres.Set(index++, pp->off, PT_RADIUS);
+			}
+		});
+
+	return maxon::OK;
 }
 
-static Bool SphereIntersection(const Vector& mp, Float rad, Ray* ray, Float maxdist, Float* length)
+// the hierarchy is built once per frame, coverage queries then only visit particles along the ray.
+// It keeps its own copy of the spheres, so the gathered buffer is only temporary.
+static maxon::Result<void> BuildPV(PVRender* pv, const InitRenderStruct& irs)
 {
-	Vector z;
-	Float	 kr, ee, det, s, s1;
-
-	kr	= rad * rad;
-	z		= (Vector)ray->p - mp;
-	ee	= Dot((Vector)ray->v, z);
-	det = ee * ee - z.GetSquaredLength() + kr;
+	iferr_scope;
 
-	if (det < 0.0)
-		return false;
+	ParticleSpheres spheres;
+	if (irs.doc)
+		FillPV(spheres, irs.doc) iferr_return;
 
-	det = Sqrt(det);
-	s = det - ee;
+	pv->bvh.Build(spheres) iferr_return;
 
-	if (s <= 0.0)
-		return false;
+	// without render context (e.g. material preview without a VolumeData) nothing is cached
+	if (irs.vd)
+		pv->rayCache.Resize(irs.vd->GetCpuCount()) iferr_return;
 
-	s1 = -det - ee;
+	return maxon::OK;
+}
 
-	if (s1 >= maxdist)
-		return false;
+INITRENDERRESULT ParticleVolume::InitRender(BaseMaterial* mat, const InitRenderStruct& irs)
+{
+	render = NewObjClear(PVRender);
+	if (!render)
+		return INITRENDERRESULT::OUTOFMEMORY;
 
-	if (s >= maxdist)
-		s = maxdist;
-	if (s1 < 0.0)
-		s1 = 0.0;
+	iferr (BuildPV(render, irs))
+	{
+		DeleteObj(render);
+		return INITRENDERRESULT::OUTOFMEMORY;
+	}
 
-	*length = s - s1;
+	return INITRENDERRESULT::OK;
+}
 
-	return true;
+void ParticleVolume::FreeRender(BaseMaterial* mat)
+{
+	DeleteObj(render);
 }
 
 void ParticleVolume::CalcSurface(BaseMaterial* mat, VolumeData* vd)
@@ -172,26 +198,25 @@ void ParticleVolume::CalcSurface(BaseMaterial* mat, VolumeData* vd)
 
 static Float GetCoverage(PVRender* pv, VolumeData* sd)
 {
-#define PT_RADIUS 50.0
+	// each render cpu only touches its own entry, so no locking is needed
+	const Int cpu = sd->GetCurrentCpu();
+	if (cpu < 0 || cpu >= pv->rayCache.GetCount())
+		return pv->bvh.GetCoverage(sd->ray, sd->dist);
 
-	Int32 i;
-	Float len, maxlen = 0.0;
+	PVRayCache&	 cache = pv->rayCache[cpu];
+	const Vector p = (Vector)sd->ray->p;
+	const Vector v = (Vector)sd->ray->v;
 
-	for (i = 0; i < pv->count; i++)
-	{
-		if (!SphereIntersection(pv->mp[i], PT_RADIUS, sd->ray, sd->dist, &len))
-			continue;
-
-		len	 = len / (2.0 * PT_RADIUS);
-		len *= len;
-		len *= len;
+	if (cache.valid && cache.dist == sd->dist && cache.p == p && cache.v == v)
+		return cache.coverage;
 
-		maxlen = len + maxlen - len * maxlen;
-	}
+	cache.valid = true;
+	cache.p = p;
+	cache.v = v;
+	cache.dist = sd->dist;
+	cache.coverage = pv->bvh.GetCoverage(sd->ray, sd->dist);
 
-	if (maxlen > 1.0)
-		maxlen = 1.0;
-	return maxlen;
+	return cache.coverage;
 }
 
 void ParticleVolume::CalcVolumetric(BaseMaterial* mat, VolumeData* vd)
@@ -0,0 +1,223 @@
+#include "particlevolume_bvh.h"
+#include "maxon/sort.h"
+
+using namespace cinema;
+
+// maximum number of spheres in a leaf
+#define BVH_LEAF_SIZE	4
+
+// the tree is split at the median, so its depth is at most log2(count) + 1
+#define BVH_STACK_SIZE 64
+
+Bool SphereIntersection(const Vector& mp, Float rad, const Ray* ray, Float maxdist, Float* length)
+{
+	Vector z;
+	Float	 kr, ee, det, s, s1;
+
+	kr	= rad * rad;
+	z		= (Vector)ray->p - mp;
+	ee	= Dot((Vector)ray->v, z);
+	det = ee * ee - z.GetSquaredLength() + kr;
+
+	if (det < 0.0)
+		return false;
+
+	det = Sqrt(det);
+	s = det - ee;
+
+	if (s <= 0.0)
+		return false;
+
+	s1 = -det - ee;
+
+	if (s1 >= maxdist)
+		return false;
+
+	if (s >= maxdist)
+		s = maxdist;
+	if (s1 < 0.0)
+		s1 = 0.0;
+
+	*length = s - s1;
+
+	return true;
+}
+
+static inline void AddCoverage(Float len, Float rad, Float& maxlen)
+{
+	len	 = len / (2.0 * rad);
+	len *= len;
+	len *= len;
+
+	maxlen = len + maxlen - len * maxlen;
+}
+
+Float GetCoverageBruteForce(const ParticleSpheres& spheres, const Ray* ray, Float maxdist)
+{
+	const Int count = spheres.GetCount();
+	Float			len, maxlen = 0.0;
+
+	for (Int i = 0; i < count; i++)
+	{
+		if (SphereIntersection(spheres.GetCenter(i), spheres.radius[i], ray, maxdist, &len))
+			AddCoverage(len, spheres.radius[i], maxlen);
+	}
+
+	if (maxlen > 1.0)
+		maxlen = 1.0;
+	return maxlen;
+}
+
+maxon::Result<void> ParticleBVH::Build(const ParticleSpheres& spheres)
+{
+	iferr_scope_handler
+	{
+		Reset();
+		return err;
+	};
+
+	Reset();
+
+	const Int count = spheres.GetCount();
+
+	if (count <= 0)
+		return maxon::OK;
+
+	if (count > maxon::LIMIT<Int32>::MAX)
+		return maxon::OutOfMemoryError(MAXON_SOURCE_LOCATION);
+
+	maxon::BaseArray<Item> items;
+	items.Resize(count) iferr_return;
+	for (Int i = 0; i < count; i++)
+		items[i].index = (Int32)i;
+
+	_nodes.EnsureCapacity(2 * (count / BVH_LEAF_SIZE + 1)) iferr_return;
+	BuildNode(spheres, items, 0, (Int32)count, 0) iferr_return;
+
+	// store the spheres in leaf order
+	_spheres.Resize(count) iferr_return;
+	for (Int i = 0; i < count; i++)
+		_spheres.Set(i, spheres.GetCenter(items[i].index), spheres.radius[items[i].index]);
+
+	return maxon::OK;
+}
+
+maxon::Result<void> ParticleBVH::BuildNode(const ParticleSpheres& spheres, maxon::BaseArray<Item>& items, Int32 first, Int32 count, Int32 depth)
+{
+	iferr_scope;
+
+	const Int32 nodeIndex = (Int32)_nodes.GetCount();
+	_nodes.Append() iferr_return;
+
+	// bounds of the centers decide the split, bounds of the spheres are stored in the node
+	Vector cmin = spheres.GetCenter(items[first].index), cmax = cmin;
+	Vector bmin = cmin - Vector(spheres.radius[items[first].index]), bmax = cmax + Vector(spheres.radius[items[first].index]);
+	for (Int32 i = first + 1; i < first + count; i++)
+	{
+		const Vector c = spheres.GetCenter(items[i].index);
+		const Float	 r = spheres.radius[items[i].index];
+		cmin = Vector(FMin(cmin.x, c.x), FMin(cmin.y, c.y), FMin(cmin.z, c.z));
+		cmax = Vector(FMax(cmax.x, c.x), FMax(cmax.y, c.y), FMax(cmax.z, c.z));
+		bmin = Vector(FMin(bmin.x, c.x - r), FMin(bmin.y, c.y - r), FMin(bmin.z, c.z - r));
+		bmax = Vector(FMax(bmax.x, c.x + r), FMax(bmax.y, c.y + r), FMax(bmax.z, c.z + r));
+	}
+
+	Node& node = _nodes[nodeIndex];
+	node.bmin	 = bmin;
+	node.bmax	 = bmax;
+	node.first = first;
+	node.count = count;
+
+	// split along the longest axis of the center bounds
+	const Vector ext	= cmax - cmin;
+	const Int32	 axis = ext.x >= ext.y ? (ext.x >= ext.z ? 0 : 2) : (ext.y >= ext.z ? 1 : 2);
+
+	if (count <= BVH_LEAF_SIZE || ext[axis] <= 0.0 || depth >= BVH_STACK_SIZE - 1)
+		return maxon::OK;
+
+	const maxon::BaseArray<Float>& key = axis == 0 ? spheres.x : (axis == 1 ? spheres.y : spheres.z);
+	for (Int32 i = first; i < first + count; i++)
+		items[i].key = key[items[i].index];
+
+	maxon::SimpleSort<> sort;
+	sort.Sort(items.GetFirst() + first, count);
+
+	const Int32 half = count / 2;
+	BuildNode(spheres, items, first, half, depth + 1) iferr_return;
+
+	const Int32 second = (Int32)_nodes.GetCount();
+	BuildNode(spheres, items, first + half, count - half, depth + 1) iferr_return;
+
+	// the node reference is not valid anymore after the children were appended
+	_nodes[nodeIndex].first = second;
+	_nodes[nodeIndex].count = 0;
+
+	return maxon::OK;
+}
+
+void ParticleBVH::Reset()
+{
+	_nodes.Reset();
+	_spheres.Reset();
+}
+
+static inline Bool SegmentHitsBox(const Vector& p, const Vector& inv, Float maxdist, const Vector& bmin, const Vector& bmax)
+{
+	Float t1 = (bmin.x - p.x) * inv.x, t2 = (bmax.x - p.x) * inv.x;
+	Float tmin = FMin(t1, t2), tmax = FMax(t1, t2);
+
+	t1 = (bmin.y - p.y) * inv.y;
+	t2 = (bmax.y - p.y) * inv.y;
+	tmin = FMax(tmin, FMin(t1, t2));
+	tmax = FMin(tmax, FMax(t1, t2));
+
+	t1 = (bmin.z - p.z) * inv.z;
+	t2 = (bmax.z - p.z) * inv.z;
+	tmin = FMax(tmin, FMin(t1, t2));
+	tmax = FMin(tmax, FMax(t1, t2));
+
+	return tmax >= FMax(tmin, 0.0_f) && tmin <= maxdist;
+}
+
+Float ParticleBVH::GetCoverage(const Ray* ray, Float maxdist) const
+{
+	if (_nodes.IsEmpty())
+		return 0.0;
+
+	// a large finite value instead of infinity avoids 0 * inf for axis parallel rays
+	const Vector p = (Vector)ray->p;
+	const Vector v = (Vector)ray->v;
+	const Vector inv(v.x != 0.0 ? 1.0 / v.x : 1.0e30, v.y != 0.0 ? 1.0 / v.y : 1.0e30, v.z != 0.0 ? 1.0 / v.z : 1.0e30);
+
+	Int32 stack[BVH_STACK_SIZE];
+	Int32 top = 0;
+	Float len, maxlen = 0.0;
+
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Int32 index = stack[--top];
+		const Node& node	= _nodes[index];
+
+		if (!SegmentHitsBox(p, inv, maxdist, node.bmin, node.bmax))
+			continue;
+
+		if (node.count > 0)
+		{
+			for (Int32 i = node.first; i < node.first + node.count; i++)
+			{
+				if (SphereIntersection(_spheres.GetCenter(i), _spheres.radius[i], ray, maxdist, &len))
+					AddCoverage(len, _spheres.radius[i], maxlen);
+			}
+		}
+		else
+		{
+			stack[top++] = node.first;
+			stack[top++] = index + 1;
+		}
+	}
+
+	if (maxlen > 1.0)
+		maxlen = 1.0;
+	return maxlen;
+}
@@ -0,0 +1,119 @@
+#ifndef PARTICLEVOLUME_BVH_H__
+#define PARTICLEVOLUME_BVH_H__
+
+#include "c4d.h"
+
+//----------------------------------------------------------------------------------------
+/// Intersects a ray segment with a sphere.
+/// @param[in] mp									Center of the sphere.
+/// @param[in] rad								Radius of the sphere.
+/// @param[in] ray								The ray, ray->v must be normalized.
+/// @param[in] maxdist						Length of the ray segment.
+/// @param[out] length						Length of the part of the segment inside the sphere.
+/// @return												True if the segment hits the sphere.
+//----------------------------------------------------------------------------------------
+cinema::Bool SphereIntersection(const cinema::Vector& mp, cinema::Float rad, const cinema::Ray* ray, cinema::Float maxdist, cinema::Float* length);
+
+//----------------------------------------------------------------------------------------
+/// Particle spheres in struct-of-arrays layout.
+//----------------------------------------------------------------------------------------
+struct ParticleSpheres
+{
+	maxon::BaseArray<cinema::Float> x, y, z;
+	maxon::BaseArray<cinema::Float> radius;
+
+	cinema::Int GetCount() const { return radius.GetCount(); }
+
+	cinema::Vector GetCenter(cinema::Int i) const { return cinema::Vector(x[i], y[i], z[i]); }
+
+	maxon::Result<void> Resize(cinema::Int count)
+	{
+		iferr_scope;
+		x.Resize(count) iferr_return;
+		y.Resize(count) iferr_return;
+		z.Resize(count) iferr_return;
+		radius.Resize(count) iferr_return;
+		return maxon::OK;
+	}
+
+	void Set(cinema::Int i, const cinema::Vector& center, cinema::Float rad)
+	{
+		x[i] = center.x;
+		y[i] = center.y;
+		z[i] = center.z;
+		radius[i] = rad;
+	}
+
+	void Reset()
+	{
+		x.Reset();
+		y.Reset();
+		z.Reset();
+		radius.Reset();
+	}
+};
+
+//----------------------------------------------------------------------------------------
+/// Calculates the particle coverage of a ray segment by testing every sphere.
+/// Reference implementation for ParticleBVH::GetCoverage().
+/// @param[in] spheres						The particle spheres.
+/// @param[in] ray								The ray, ray->v must be normalized.
+/// @param[in] maxdist						Length of the ray segment.
+/// @return												The coverage in [0..1].
+//----------------------------------------------------------------------------------------
+cinema::Float GetCoverageBruteForce(const ParticleSpheres& spheres, const cinema::Ray* ray, cinema::Float maxdist);
+
+//----------------------------------------------------------------------------------------
+/// Bounding volume hierarchy over a set of particle spheres.
+/// The spheres are copied and reordered on Build() so that the leaves reference
+/// consecutive memory.
+//----------------------------------------------------------------------------------------
+class ParticleBVH
+{
+public:
+	//----------------------------------------------------------------------------------------
+	/// Builds the hierarchy, an existing one is discarded.
+	/// @param[in] spheres					The particle spheres.
+	/// @return											OK on success.
+	//----------------------------------------------------------------------------------------
+	maxon::Result<void> Build(const ParticleSpheres& spheres);
+
+	//----------------------------------------------------------------------------------------
+	/// Frees all data.
+	//----------------------------------------------------------------------------------------
+	void Reset();
+
+	//----------------------------------------------------------------------------------------
+	/// Calculates the particle coverage of a ray segment, only spheres whose
+	/// nodes are hit by the segment are tested.
+	/// @param[in] ray							The ray, ray->v must be normalized.
+	/// @param[in] maxdist					Length of the ray segment.
+	/// @return											The coverage in [0..1], same as GetCoverageBruteForce().
+	//----------------------------------------------------------------------------------------
+	cinema::Float GetCoverage(const cinema::Ray* ray, cinema::Float maxdist) const;
+
+	cinema::Int GetCount() const { return _spheres.GetCount(); }
+
+private:
+	struct Node
+	{
+		cinema::Vector	bmin, bmax;		// bounds of the spheres below this node
+		cinema::Int32		first;				// leaf: first sphere, inner node: index of the second child (the first child follows the node)
+		cinema::Int32		count;				// number of spheres for a leaf, 0 for an inner node
+	};
+
+	struct Item
+	{
+		cinema::Float		key;
+		cinema::Int32		index;
+
+		cinema::Bool operator <(const Item& other) const { return key < other.key; }
+	};
+
+	maxon::Result<void> BuildNode(const ParticleSpheres& spheres, maxon::BaseArray<Item>& items, cinema::Int32 first, cinema::Int32 count, cinema::Int32 depth);
+
+	maxon::BaseArray<Node>	_nodes;
+	ParticleSpheres					_spheres;		// copy of the spheres in leaf order
+};
+
+#endif // PARTICLEVOLUME_BVH_H__
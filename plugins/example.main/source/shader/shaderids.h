@@ -0,0 +1,10 @@
+#ifndef SHADERIDS_H__
+#define SHADERIDS_H__
+
+// plugin IDs of the shaders, shared with the speed tests in maxonsdk/unittests
+// be sure to use a unique ID obtained from www.plugincafe.com
+#define ID_BITMAPDISTORTION	1001160
+#define ID_SDKGRADIENT			1001161
+#define ID_MANDELBROT				1001162
+
+#endif // SHADERIDS_H__
@@ -10,19 +10,48 @@
 // be sure to use a unique ID obtained from www.plugincafe.com
 #define ID_SIMPLEMAT 1001164
 
+// number of lights whose diffuse and specular terms are evaluated together
+#define SIMPLE_LIGHT_LANES 4
+
+// specular exponent of the illumination model, the lanes raise to this power by multiplication
+#define SIMPLE_SPECULAR_EXPONENT 5
+
 using namespace cinema;
 
+// light classes of the per-render light table
+enum
+{
+	SIMPLELIGHT_AMBIENT = 0,
+	SIMPLELIGHT_AREA,
+	SIMPLELIGHT_DIRECT
+};
+
+// static properties of a light, classified once per render
+struct SimpleLight
+{
+	Int32						cls;
+	Bool						restricted;
+	Bool						diffuse;
+	Bool						specular;
+	Float						trn;
+};
+
 class SimpleMaterial : public MaterialData
 {
 	INSTANCEOF(SimpleMaterial, MaterialData)
 
 private:
 	Vector color;
+	maxon::HashMap<const RayLight*, SimpleLight> lights;
 
 public:
+	// returns the classification of a light of the render or nullptr if it is not known
+	const SimpleLight* FindLight(const RayLight* ls) const { return lights.FindValue(ls); }
+
 	virtual Bool Init(GeListNode* node, Bool isCloneInit);
 	virtual	void CalcSurface(BaseMaterial* mat, VolumeData* vd);
 	virtual	INITRENDERRESULT InitRender(BaseMaterial* mat, const InitRenderStruct& irs);
+	virtual	void FreeRender(BaseMaterial* mat);
 	virtual Bool GetDParameter(const GeListNode* node, const DescID& id, GeData& t_data, DESCFLAGS_GET& flags) const;
 	virtual Bool SetDParameter(GeListNode* node, const DescID& id, const GeData& t_data, DESCFLAGS_SET& flags);
 	virtual Bool Message(GeListNode* node, Int32 type, void* data);
@@ -52,67 +81,167 @@ Bool SimpleMaterial::Init(GeListNode* node, Bool isCloneInit)
 	return true;
 }
 
+static void ClassifyLight(const RayLight* ls, SimpleLight& info)
+{
+	info.cls = ls->ambient ? SIMPLELIGHT_AMBIENT : (ls->arealight ? SIMPLELIGHT_AREA : SIMPLELIGHT_DIRECT);
+	info.restricted = ls->lr.object != nullptr;
+	info.diffuse = !ls->nodiffuse;
+	info.specular = !ls->nospecular;
+	info.trn = ls->trn;
+}
+
 INITRENDERRESULT SimpleMaterial::InitRender(BaseMaterial* mat, const InitRenderStruct& irs)
 {
 	BaseContainer* data = mat->GetDataInstance();
 	color = data->GetVector(SIMPLEMATERIAL_COLOR);
+
+	// classify the lights of the render once. The components of a light cache are not in the
+	// order of GetLight(), so the lights are found by their pointer. SimpleIllumModel falls
+	// back to classifying inline if a light is not in the table.
+	lights.Reset();
+	if (irs.vd)
+	{
+		const Int32 count = irs.vd->GetLightCount();
+		for (Int32 i = 0; i < count; i++)
+		{
+			const RayLight* ls = irs.vd->GetLight(i);
+			if (!ls)
+				continue;
+
+			iferr (SimpleLight& info = lights.InsertKey(ls))
+				return INITRENDERRESULT::OUTOFMEMORY;
+			ClassifyLight(ls, info);
+		}
+	}
+
 	return INITRENDERRESULT::OK;
 }
 
+void SimpleMaterial::FreeRender(BaseMaterial* mat)
+{
+	lights.Reset();
+}
+
+// direct lights collected for evaluation in lanes
+struct SimpleLightLanes
+{
+	RayLightComponent* lc[SIMPLE_LIGHT_LANES];
+	Float							 trn[SIMPLE_LIGHT_LANES];
+	Bool							 diffuse[SIMPLE_LIGHT_LANES];
+	Bool							 specular[SIMPLE_LIGHT_LANES];
+	Int32							 cnt;
+};
+
+static void EvaluateLanes(VolumeData* sd, SimpleLightLanes& lanes, RayLightCache* rlc)
+{
+	Float				 lx[SIMPLE_LIGHT_LANES], ly[SIMPLE_LIGHT_LANES], lz[SIMPLE_LIGHT_LANES];
+	Float				 dif[SIMPLE_LIGHT_LANES], spc[SIMPLE_LIGHT_LANES];
+	const Vector n	 = sd->bumpn;
+	const Vector v	 = (Vector)sd->ray->v;
+	const Float	 vn	 = Dot(v, n);
+	Int32				 l;
+
+	// unused lanes are padded with a zero vector and contribute neither diffuse nor specular
+	for (l = 0; l < SIMPLE_LIGHT_LANES; l++)
+	{
+		const Vector lv = l < lanes.cnt ? (Vector)lanes.lc[l]->lv : Vector(0.0);
+		lx[l] = lv.x;
+		ly[l] = lv.y;
+		lz[l] = lv.z;
+
+		if (l >= lanes.cnt)
+			lanes.diffuse[l] = lanes.specular[l] = false;
+	}
+
+	// cosb = Dot(v, lv - n * 2 * cosa) = Dot(v, lv) - 2 * cosa * Dot(v, n)
+	for (l = 0; l < SIMPLE_LIGHT_LANES; l++)
+	{
+		const Float cosa = n.x * lx[l] + n.y * ly[l] + n.z * lz[l];
+		const Float cosb = v.x * lx[l] + v.y * ly[l] + v.z * lz[l] - 2.0 * cosa * vn;
+
+		dif[l] = (lanes.diffuse[l] && sd->cosc * cosa >= 0.0) ? Abs(cosa) : 0.0;
+
+		// cosb ^ SIMPLE_SPECULAR_EXPONENT
+		const Float s	 = (lanes.specular[l] && cosb > 0.0) ? cosb : 0.0;
+		const Float s2 = s * s;
+		spc[l] = s2 * s2 * s;
+	}
+
+	for (l = 0; l < lanes.cnt; l++)
+	{
+		RayLightComponent* lc = lanes.lc[l];
+
+		// only lights with a contrast need the power of the diffuse term
+		lc->rdiffuse	= Vector(lanes.trn[l] != 1.0 && dif[l] > 0.0 ? Pow(dif[l], lanes.trn[l]) : dif[l]);
+		lc->rspecular = Vector(spc[l]);
+
+		rlc->diffuse	+= lc->rdiffuse * lc->col;
+		rlc->specular += lc->rspecular * lc->col;
+	}
+
+	lanes.cnt = 0;
+}
+
 static void SimpleIllumModel(VolumeData* sd, RayLightCache* rlc, void* dat)
 {
-	Bool	nodif, nospec;
-	Int32	i;
-	Float	cosa, cosb, exponent = 5.0;
-	const Vector64& v = sd->ray->v;
+	const SimpleMaterial* material = static_cast<const SimpleMaterial*>(dat);
+	Bool									nodif, nospec;
+	Int32									i;
+	const Float						exponent = SIMPLE_SPECULAR_EXPONENT;
+	const Vector64&				v = sd->ray->v;
+	SimpleLight						local;
+	SimpleLightLanes			lanes;
 
 	rlc->diffuse = rlc->specular = Vector(0.0);
+	lanes.cnt = 0;
 
 	for (i = 0; i < rlc->cnt; i++)
 	{
 		RayLightComponent* lc = rlc->comp[i];
-		if (lc->lv.IsZero())
-			continue;		// light invisible
-
-		RayLight* ls = lc->light;
+		lc->rdiffuse = lc->rspecular = Vector(0.0);
 
-		nodif = nospec = false;
-		if (ls->lr.object)
-			CalcRestrictionInc(&ls->lr, sd->op, nodif, nospec);
+		// invisible lights and range-limited lights that do not reach the point are skipped before any shading
+		if (lc->lv.IsZero() || lc->col.IsZero())
+			continue;
 
-		lc->rdiffuse = lc->rspecular = Vector(0.0);
-		if (ls->ambient)
-		{
-			lc->rdiffuse = Vector(1.0);
-		}
-		else if (ls->arealight)
+		RayLight*					 ls = lc->light;
+		const SimpleLight* info = material->FindLight(ls);
+		if (!info)
 		{
-			sd->CalcArea(ls, nodif, nospec, exponent, v, sd->p, sd->bumpn, sd->orign, sd->raybits, false, &lc->rdiffuse, &lc->rspecular);
+			ClassifyLight(ls, local);
+			info = &local;
 		}
-		else
-		{
-			cosa = Dot(sd->bumpn, lc->lv);
-			if (!(ls->nodiffuse || nodif) && sd->cosc * cosa >= 0.0)
-			{
-				Float trn = ls->trn;
-				if (trn != 1.0)
-					lc->rdiffuse = Vector(Pow(Abs(cosa), trn));
-				else
-					lc->rdiffuse = Vector(Abs(cosa));
-			}
 
-			if (!(ls->nospecular || nospec))
-			{
-				cosb = Dot(v, lc->lv - sd->bumpn * (2.0 * cosa));
+		nodif = nospec = false;
+		if (info->restricted)
+			CalcRestrictionInc(&ls->lr, sd->op, nodif, nospec);
 
-				if (cosb > 0.0)
-					lc->rspecular = Vector(Pow(cosb, exponent));
-			}
+		switch (info->cls)
+		{
+			case SIMPLELIGHT_AMBIENT:
+				lc->rdiffuse = Vector(1.0);
+				rlc->diffuse += lc->col;
+				break;
+
+			case SIMPLELIGHT_AREA:
+				sd->CalcArea(ls, nodif, nospec, exponent, v, sd->p, sd->bumpn, sd->orign, sd->raybits, false, &lc->rdiffuse, &lc->rspecular);
+				rlc->diffuse	+= lc->rdiffuse * lc->col;
+				rlc->specular += lc->rspecular * lc->col;
+				break;
+
+			default:
+				lanes.lc[lanes.cnt] = lc;
+				lanes.trn[lanes.cnt] = info->trn;
+				lanes.diffuse[lanes.cnt] = info->diffuse && !nodif;
+				lanes.specular[lanes.cnt] = info->specular && !nospec;
+				if (++lanes.cnt == SIMPLE_LIGHT_LANES)
+					EvaluateLanes(sd, lanes, rlc);
+				break;
 		}
-
-		rlc->diffuse	+= lc->rdiffuse * lc->col;
-		rlc->specular += lc->rspecular * lc->col;
 	}
+
+	if (lanes.cnt > 0)
+		EvaluateLanes(sd, lanes, rlc);
 }
 
 void SimpleMaterial::CalcSurface(BaseMaterial* mat, VolumeData* vd)
@@ -1,12 +1,63 @@
 // example code of interacting with Hair at render time
 
+#include "maxon/atomictypes.h"
 #include "c4d.h"
 #include "c4d_symbols.h"
 #include "main.h"
 #include "lib_hair.h"
+#include "vphairsdkpost.h"
 
 using namespace cinema;
 
+// number of shadow lookups a cpu keeps, a power of two
+#define HAIR_SHADOW_CACHE_SIZE 256
+
+typedef Float (*HairShadowHook)(HairVideoPost* vp, VolumeData* vd, RayLight* light, const Vector& p, Float delta, Int32 cpu);
+
+// be sure to use a unique ID obtained from www.plugincafe.com
+#define ID_HAIR_COLLIDER_EXAMPLE 1018971
+
+// a shadow lookup of a light with a sample width in a cell of the quantized position
+struct HairShadowCacheEntry
+{
+	const RayLight* light;
+	Int64						x, y, z;
+	Float						delta;
+	Float						value;
+};
+
+// shadow lookups and hit counters of a cpu, only accessed by the hooks of this cpu
+struct HairShadowCpuCache
+{
+	HairShadowCacheEntry entries[HAIR_SHADOW_CACHE_SIZE];
+	Int64								 hits, misses;
+};
+
+// neighbouring segments of a strand query nearly the same position, a direct-mapped
+// cache per cpu serves these lookups without evaluating the shadow buffer again.
+// A miss is evaluated by the shadow hook that was set before, the cache is only
+// active if there is one. The lights and positions change from frame to frame, the
+// entries are cleared for every frame but their memory is kept for the frame sequence.
+class HairShadowCache
+{
+public:
+	maxon::Result<void> Init(Int cpuCount, Float cellSize, HairShadowHook nextHook);
+	void Deactivate() { _next = nullptr; }
+	void Reset();
+
+	Bool IsActive() const { return _next != nullptr; }
+
+	Float Sample(HairVideoPost* vp, VolumeData* vd, RayLight* light, const Vector& p, Float delta, Int32 cpu);
+
+	// prints the hits and misses of all cpus, for tuning the cell size
+	void ReportHits() const;
+
+private:
+	maxon::BaseArray<HairShadowCpuCache> _cpus;
+	Float																 _invCellSize = 1.0;
+	HairShadowHook											 _next = nullptr;	// the hook that was set before, evaluates a miss
+};
+
 class HairSDKVideopost : public VideoPostData
 {
 	INSTANCEOF(HairSDKVideopost, VideoPostData)
@@ -21,6 +72,9 @@ public:
 	virtual Bool RenderEngineCheck(const BaseVideoPost* node, Int32 id) const;
 
 	void* m_pOldColorHook;
+	void* m_pOldShadowHook;
+
+	HairShadowCache m_ShadowCache;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -30,13 +84,94 @@ static Vector _SampleHairColorHook(HairVideoPost* vp, Int32 oindex, HairMaterial
 	return Vector(1, 0, 0);
 }
 
-#if 0
-static Float _SampleHairTransparencyHook(HairVideoPost* vp, Int32 oindex, HairMaterialData* mat, RayObject* ro, HairObject* op, HairGuides* guides, BaseList2D* bl, Float* thk, VolumeData* vd, Int32 cpu, Int32 lid, Int32 seg, Int32 p, Float lined, const Vector& linep, const Vector& n, const Vector& lp, const Vector& huv, Int32 ply_id)
+// the hook has no user data. The cache is registered here when the render starts, only
+// one render at a time can use it, the hook is not set for the others.
+static maxon::AtomicPtr<HairShadowCache> g_shadowCache;
+
+static Float _SampleShadowBufferHook(HairVideoPost* vp, VolumeData* vd, RayLight* light, const Vector& p, Float delta, Int32 cpu)
 {
-	return 1.0;
+	// the hook is only set while the registered cache is active
+	HairShadowCache* cache = g_shadowCache.LoadAcquire();
+	if (!cache)
+		return 1.0;
+
+	return cache->Sample(vp, vd, light, p, delta, cpu);
 }
 
-static Float _SampleShadowBufferHook(HairVideoPost* vp, VolumeData* vd, RayLight* light, const Vector& p, Float delta, Int32 cpu)
+maxon::Result<void> HairShadowCache::Init(Int cpuCount, Float cellSize, HairShadowHook nextHook)
+{
+	iferr_scope;
+
+	// the memory of the previous frame is reused
+	if (_cpus.GetCount() != cpuCount)
+		_cpus.Resize(cpuCount) iferr_return;
+
+	for (HairShadowCpuCache& c : _cpus)
+	{
+		for (HairShadowCacheEntry& e : c.entries)
+			e.light = nullptr;
+		c.hits = c.misses = 0;
+	}
+
+	_invCellSize = 1.0 / maxon::Max(cellSize, 0.001);
+	_next = nextHook;
+
+	return maxon::OK;
+}
+
+void HairShadowCache::Reset()
+{
+	_cpus.Reset();
+	_next = nullptr;
+}
+
+Float HairShadowCache::Sample(HairVideoPost* vp, VolumeData* vd, RayLight* light, const Vector& p, Float delta, Int32 cpu)
+{
+	if (!light || cpu < 0 || cpu >= _cpus.GetCount())
+		return _next(vp, vd, light, p, delta, cpu);
+
+	const Int64 x = (Int64)Floor(p.x * _invCellSize);
+	const Int64 y = (Int64)Floor(p.y * _invCellSize);
+	const Int64 z = (Int64)Floor(p.z * _invCellSize);
+
+	const UInt64 hash = (UInt64(x) * 73856093) ^ (UInt64(y) * 19349663) ^ (UInt64(z) * 83492791) ^ (UInt64)reinterpret_cast<UInt>(light);
+
+	HairShadowCpuCache&		c = _cpus[cpu];
+	HairShadowCacheEntry& e = c.entries[(hash ^ (hash >> 17)) & (HAIR_SHADOW_CACHE_SIZE - 1)];
+
+	// the sample width changes the softness of the shadow, it is part of the key
+	if (e.light == light && e.x == x && e.y == y && e.z == z && e.delta == delta)
+	{
+		c.hits++;
+		return e.value;
+	}
+
+	c.misses++;
+	e.value = _next(vp, vd, light, p, delta, cpu);
+	e.light = light;
+	e.x = x;
+	e.y = y;
+	e.z = z;
+	e.delta = delta;
+
+	return e.value;
+}
+
+void HairShadowCache::ReportHits() const
+{
+	Int64 hits = 0, misses = 0;
+	for (const HairShadowCpuCache& c : _cpus)
+	{
+		hits += c.hits;
+		misses += c.misses;
+	}
+
+	if (hits + misses > 0)
+		ApplicationOutput("Hair shadow cache: @ hits, @ misses, @% hit rate", hits, misses, Int64(hits * 100 / (hits + misses)));
+}
+
+#if 0
+static Float _SampleHairTransparencyHook(HairVideoPost* vp, Int32 oindex, HairMaterialData* mat, RayObject* ro, HairObject* op, HairGuides* guides, BaseList2D* bl, Float* thk, VolumeData* vd, Int32 cpu, Int32 lid, Int32 seg, Int32 p, Float lined, const Vector& linep, const Vector& n, const Vector& lp, const Vector& huv, Int32 ply_id)
 {
 	return 1.0;
 }
@@ -51,8 +186,13 @@ static Bool _IlluminateHook(HairVideoPost* vp, VolumeData* vd, RayLight* light,
 
 Bool HairSDKVideopost::Init(GeListNode* node, Bool isCloneInit)
 {
-	//BaseVideoPost *pp = (BaseVideoPost*)node;
-	//BaseContainer  *dat = pp->GetDataInstance();
+	BaseVideoPost* pp	 = (BaseVideoPost*)node;
+	BaseContainer* dat = pp->GetDataInstance();
+	if (!isCloneInit)
+	{
+		dat->SetBool(HAIRSDKPOST_SHADOW_CACHE, false);
+		dat->SetFloat(HAIRSDKPOST_SHADOW_CACHE_CELL, 1.0);
+	}
 
 	return true;
 }
@@ -68,7 +208,11 @@ Bool HairSDKVideopost::RenderEngineCheck(const BaseVideoPost* node, Int32 id) co
 
 RENDERRESULT HairSDKVideopost::Execute(BaseVideoPost* node, VideoPostStruct* vps)
 {
-	if (vps->vp == VIDEOPOSTCALL::RENDER)
+	if (vps->vp == VIDEOPOSTCALL::FRAMESEQUENCE && !vps->open)
+	{
+		m_ShadowCache.Reset();
+	}
+	else if (vps->vp == VIDEOPOSTCALL::RENDER)
 	{
 		HairLibrary hlib;
 
@@ -76,12 +220,42 @@ RENDERRESULT HairSDKVideopost::Execute(BaseVideoPost* node, VideoPostStruct* vps
 		{
 			m_pOldColorHook = hlib.SetHook(vps->doc, HAIR_HOOK_TYPE_SAMPLE_COLOR, (void*)_SampleHairColorHook);
 			//hlib.SetHook(vps->doc,HAIR_HOOK_TYPE_SAMPLE_TRANS,_SampleHairTransparencyHook);
-			//hlib.SetHook(vps->doc,HAIR_HOOK_TYPE_SAMPLE_SHADOWS,_SampleShadowBufferHook);
 			//hlib.SetHook(vps->doc,HAIR_HOOK_TYPE_ILLUMINATE,_IlluminateHook);
+
+			const BaseContainer* dat = node->GetDataInstance();
+			if (dat->GetBool(HAIRSDKPOST_SHADOW_CACHE))
+			{
+				m_pOldShadowHook = hlib.SetHook(vps->doc, HAIR_HOOK_TYPE_SAMPLE_SHADOWS, (void*)_SampleShadowBufferHook);
+
+				// without a hook to evaluate the misses, or if another instance or render caches already, the hook is taken back
+				if (!m_pOldShadowHook || m_pOldShadowHook == (void*)_SampleShadowBufferHook || !g_shadowCache.TryCompareAndSwap(&m_ShadowCache, nullptr))
+				{
+					hlib.SetHook(vps->doc, HAIR_HOOK_TYPE_SAMPLE_SHADOWS, m_pOldShadowHook);
+				}
+				else
+				{
+					const Int cpuCount = vps->vd ? vps->vd->GetCpuCount() : GeGetCurrentThreadCount();
+					iferr (m_ShadowCache.Init(cpuCount, dat->GetFloat(HAIRSDKPOST_SHADOW_CACHE_CELL, 1.0), (HairShadowHook)m_pOldShadowHook))
+					{
+						m_ShadowCache.Reset();
+						g_shadowCache.StoreRelease(nullptr);
+						hlib.SetHook(vps->doc, HAIR_HOOK_TYPE_SAMPLE_SHADOWS, m_pOldShadowHook);
+						return RENDERRESULT::OUTOFMEMORY;
+					}
+				}
+			}
 		}
 		else
 		{
 			hlib.SetHook(vps->doc, HAIR_HOOK_TYPE_SAMPLE_COLOR, m_pOldColorHook);
+
+			if (m_ShadowCache.IsActive())
+			{
+				hlib.SetHook(vps->doc, HAIR_HOOK_TYPE_SAMPLE_SHADOWS, m_pOldShadowHook);
+				g_shadowCache.StoreRelease(nullptr);
+				m_ShadowCache.ReportHits();
+				m_ShadowCache.Deactivate();
+			}
 		}
 	}
 
@@ -89,8 +263,6 @@ RENDERRESULT HairSDKVideopost::Execute(BaseVideoPost* node, VideoPostStruct* vps
 }
 
 
-#define ID_HAIR_COLLIDER_EXAMPLE 1018971
-
 Bool RegisterVideopost()
 {
 	return RegisterVideoPostPlugin(ID_HAIR_COLLIDER_EXAMPLE, GeLoadString(IDS_HAIR_VIDEOPOST_EXAMPLE), PLUGINFLAG_VIDEOPOST_MULTIPLE, HairSDKVideopost::Alloc, "VPhairsdkpost"_s, 0, 0);
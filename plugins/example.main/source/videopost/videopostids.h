@@ -0,0 +1,13 @@
+#ifndef VIDEOPOSTIDS_H__
+#define VIDEOPOSTIDS_H__
+
+// plugin IDs of the video posts, shared with the speed tests in maxonsdk/unittests
+// be sure to use a unique ID obtained from www.plugincafe.com
+#define ID_INVERTVIDEOPOST		1000455
+#define ID_COLORIZEVIDEOPOST	1000968
+#define ID_VISUALIZENORMALS		1000986
+
+// message IDs private to the SDK video posts, registered like plugin IDs
+#define ID_MSG_VPFUSED				1001166
+
+#endif // VIDEOPOSTIDS_H__
@@ -0,0 +1,267 @@
+#ifndef VPBLOCK_H__
+#define VPBLOCK_H__
+
+#include "maxon/atomictypes.h"
+#include "maxon/parallelfor.h"
+#include "maxon/spinlock.h"
+#include "c4d.h"
+
+//----------------------------------------------------------------------------------------
+/// A block of consecutive rows of a VPBuffer in one piece of memory.
+/// The rows are stored GetStride() components apart at the bit depth the block was
+/// loaded with, 8 bit as UChar, 16 bit as UInt16 and 32 bit as Float32.
+/// Only rows marked with Touch() are written back by Store(). The memory is kept
+/// when a block is loaded again, so a block that is reused is allocation-free.
+//----------------------------------------------------------------------------------------
+class VPBlock
+{
+public:
+	//----------------------------------------------------------------------------------------
+	/// Reads rows from a buffer. BUFFER has the GetInfo(), GetLine() and SetLine() methods of VPBuffer.
+	/// @param[in] buffer							The buffer.
+	/// @param[in] x1									First column.
+	/// @param[in] y1									First row.
+	/// @param[in] cnt								Number of pixels per row.
+	/// @param[in] rows								Number of rows.
+	/// @param[in] bitdepth						8, 16 or 32, or 0 for the bit depth of the buffer.
+	/// @return												OK on success.
+	//----------------------------------------------------------------------------------------
+	template <typename BUFFER> maxon::Result<void> Load(BUFFER* buffer, cinema::Int32 x1, cinema::Int32 y1, cinema::Int32 cnt, cinema::Int32 rows, cinema::Int32 bitdepth)
+	{
+		iferr_scope;
+
+		_x1 = x1;
+		_y1 = y1;
+		_cnt = cnt;
+		_rows = rows;
+		_cpp = (cinema::Int32)buffer->GetInfo(cinema::VPGETINFO::CPP);
+		_bitdepth = bitdepth > 0 ? bitdepth : (cinema::Int32)buffer->GetInfo(cinema::VPGETINFO::BITDEPTH);
+		if (_bitdepth != 8 && _bitdepth != 16)
+			_bitdepth = 32;
+		_stride = cinema::Int(cnt) * _cpp;
+
+		_memory.Resize(_stride * rows * (_bitdepth / 8)) iferr_return;
+		_touched.Resize(rows) iferr_return;
+
+		for (cinema::Int32 i = 0; i < rows; i++)
+		{
+			_touched[i] = false;
+			buffer->GetLine(x1, y1 + i, cnt, GetRowData(y1 + i), _bitdepth, true);
+		}
+
+		return maxon::OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Writes the touched rows back to a buffer.
+	/// @param[in] buffer							The buffer the block was loaded from.
+	//----------------------------------------------------------------------------------------
+	template <typename BUFFER> void Store(BUFFER* buffer)
+	{
+		for (cinema::Int32 i = 0; i < _rows; i++)
+		{
+			if (_touched[i])
+				buffer->SetLine(_x1, _y1 + i, _cnt, GetRowData(_y1 + i), _bitdepth, true);
+		}
+	}
+
+	cinema::Int32 GetLeft() const { return _x1; }
+	cinema::Int32 GetTop() const { return _y1; }
+	cinema::Int32 GetBottom() const { return _y1 + _rows - 1; }
+	cinema::Int32 GetWidth() const { return _cnt; }
+	cinema::Int32 GetComponents() const { return _cpp; }
+	cinema::Int32 GetBitDepth() const { return _bitdepth; }
+	cinema::Int GetStride() const { return _stride; }
+
+	//----------------------------------------------------------------------------------------
+	/// Returns a row of the block.
+	/// @param[in] y									Row in buffer coordinates, GetTop() ... GetBottom().
+	/// @return												The first component of the row, T must match the bit depth.
+	//----------------------------------------------------------------------------------------
+	template <typename T> T* GetRow(cinema::Int32 y)
+	{
+		DebugAssert(SIZEOF(T) * 8 == _bitdepth);
+		return reinterpret_cast<T*>(_memory.GetFirst()) + (y - _y1) * _stride;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Fetches the fragment lists of all rows of the block, see VolumeData::GetFragments().
+	/// VolumeData is shared by all workers and GetFragments() is not documented to be thread-safe,
+	/// so the rows of a block are fetched under the lock at once and evaluated without it.
+	/// @param[in] vd									The volume data of the render.
+	/// @param[in] flags							The data of the fragments.
+	/// @param[in] lock								Shared by all blocks of a pass.
+	/// @return												OK on success.
+	//----------------------------------------------------------------------------------------
+	maxon::Result<void> LoadFragments(cinema::VolumeData* vd, cinema::VPGETFRAGMENTS flags, maxon::Spinlock& lock)
+	{
+		iferr_scope;
+
+		FreeFragments();
+		_fragments.Resize(_rows) iferr_return;
+
+		maxon::ScopedLock guard(lock);
+		for (cinema::Int32 i = 0; i < _rows; i++)
+			_fragments[i] = vd->GetFragments(_x1, _y1 + i, _cnt, flags);
+
+		return maxon::OK;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Returns the fragment lists of a row fetched by LoadFragments().
+	/// @param[in] y									Row in buffer coordinates, GetTop() ... GetBottom().
+	/// @return												A list per pixel of the row, or nullptr if there are none.
+	//----------------------------------------------------------------------------------------
+	const cinema::VPFragment** GetFragments(cinema::Int32 y) const
+	{
+		const cinema::Int i = y - _y1;
+		return i < _fragments.GetCount() ? _fragments[i] : nullptr;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Frees the fragment lists of LoadFragments(), the memory of the block is kept.
+	//----------------------------------------------------------------------------------------
+	void FreeFragments()
+	{
+		for (const cinema::VPFragment** frag : _fragments)
+			DeleteMem(frag);
+		_fragments.Flush();
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Marks a row as changed, it is written back by Store().
+	/// @param[in] y									Row in buffer coordinates, GetTop() ... GetBottom().
+	//----------------------------------------------------------------------------------------
+	void Touch(cinema::Int32 y) { _touched[y - _y1] = true; }
+
+	cinema::Bool IsTouched(cinema::Int32 y) const { return _touched[y - _y1]; }
+
+	//----------------------------------------------------------------------------------------
+	/// Frees all data.
+	//----------------------------------------------------------------------------------------
+	void Reset()
+	{
+		FreeFragments();
+		_fragments.Reset();
+		_memory.Reset();
+		_touched.Reset();
+		_rows = 0;
+	}
+
+private:
+	void* GetRowData(cinema::Int32 y) { return _memory.GetFirst() + (y - _y1) * _stride * (_bitdepth / 8); }
+
+	maxon::BaseArray<cinema::UChar> _memory;
+	maxon::BaseArray<cinema::Bool>	_touched;
+	maxon::BaseArray<const cinema::VPFragment**> _fragments;
+	cinema::Int32										_x1 = 0, _y1 = 0, _cnt = 0, _rows = 0, _cpp = 0, _bitdepth = 32;
+	cinema::Int											_stride = 0;
+};
+
+//----------------------------------------------------------------------------------------
+/// Runs a kernel over the rectangle x1, y1, x2, y2 of a buffer in blocks of rowsPerBlock rows.
+/// The blocks are processed concurrently. Every worker uses the block of the pool with
+/// its index, the pool grows to the number of threads and is meant to be kept by the
+/// video post from frame to frame.
+/// @param[in] buffer							The buffer, see VPBlock::Load().
+/// @param[in] x1									First column.
+/// @param[in] y1									First row.
+/// @param[in] x2									Last column.
+/// @param[in] y2									Last row.
+/// @param[in] rowsPerBlock				Number of rows per block.
+/// @param[in] bitdepth						8, 16 or 32, or 0 for the bit depth of the buffer.
+/// @param[in,out] pool						Blocks of the workers.
+/// @param[in] thread							Checked for a break before every block, may be nullptr.
+/// @param[in] fn									Called as Result<void> fn(VPBlock& block) for every block, has to touch the rows it changed.
+/// @return												OK on success, OperationCancelledError if blocks were skipped because of a break, otherwise the first error of a block.
+//----------------------------------------------------------------------------------------
+template <typename BUFFER, typename FN> maxon::Result<void> ProcessRowBlocks(BUFFER* buffer, cinema::Int32 x1, cinema::Int32 y1, cinema::Int32 x2, cinema::Int32 y2, cinema::Int32 rowsPerBlock, cinema::Int32 bitdepth, maxon::BaseArray<VPBlock>& pool, cinema::BaseThread* thread, FN&& fn)
+{
+	iferr_scope;
+
+	if (!buffer || x2 < x1 || y2 < y1 || rowsPerBlock <= 0)
+		return maxon::OK;
+
+	const cinema::Int threadCount = maxon::ThreadRef::GetCurrentThreadCount();
+	if (pool.GetCount() < threadCount)
+		pool.Resize(threadCount) iferr_return;
+
+	struct BlockContext : public maxon::ParallelFor::BaseContext
+	{
+		VPBlock* block = nullptr;
+		VPBlock	 local;		// only used if the pool has no block for this worker
+	};
+
+	const cinema::Int32 cnt = x2 - x1 + 1;
+	const cinema::Int32 blockCount = (y2 - y1 + rowsPerBlock) / rowsPerBlock;
+
+	maxon::AtomicBool failed, broken;
+	maxon::Spinlock		lock;
+	maxon::Error			error;
+
+	maxon::ParallelFor::Dynamic<BlockContext>(0, blockCount,
+		[&pool](BlockContext& context)
+		{
+			const cinema::Int index = context.GetLocalThreadIndex();
+			context.block = index < pool.GetCount() ? &pool[index] : &context.local;
+		},
+		[buffer, thread, &fn, &failed, &broken, &lock, &error, x1, y1, y2, cnt, rowsPerBlock, bitdepth](cinema::Int index, BlockContext& context)
+		{
+			if (failed.Get())
+				return;
+
+			if (thread && thread->TestBreak())
+			{
+				broken.Set(true);
+				return;
+			}
+
+			const cinema::Int32 yStart = y1 + cinema::Int32(index) * rowsPerBlock;
+			const cinema::Int32 rows = maxon::Min(y2 - yStart + 1, rowsPerBlock);
+			VPBlock&						block = *context.block;
+
+			iferr (block.Load(buffer, x1, yStart, cnt, rows, bitdepth))
+			{
+				maxon::ScopedLock guard(lock);
+				if (!failed.Get())
+					error = err;
+				failed.Set(true);
+				return;
+			}
+
+			iferr (fn(block))
+			{
+				maxon::ScopedLock guard(lock);
+				if (!failed.Get())
+					error = err;
+				failed.Set(true);
+				return;
+			}
+
+			block.Store(buffer);
+		},
+		[](BlockContext& context)
+		{
+		}, maxon::ParallelFor::Granularity(1));
+
+	if (failed.Get())
+		return error;
+
+	// the skipped blocks were not processed, the image is incomplete
+	if (broken.Get())
+		return maxon::OperationCancelledError(MAXON_SOURCE_LOCATION);
+
+	return maxon::OK;
+}
+
+//----------------------------------------------------------------------------------------
+/// Converts an error of a pass over the image into the result of a video post.
+/// @param[in] err								The error of ProcessRowBlocks() or of a pass that uses it.
+/// @return												RENDERRESULT::USERBREAK if the pass was interrupted, otherwise RENDERRESULT::OUTOFMEMORY.
+//----------------------------------------------------------------------------------------
+inline cinema::RENDERRESULT GetPassResult(const maxon::Error& err)
+{
+	return err.IsInstanceOf<maxon::OperationCancelledError>() ? cinema::RENDERRESULT::USERBREAK : cinema::RENDERRESULT::OUTOFMEMORY;
+}
+
+#endif // VPBLOCK_H__
@@ -10,6 +10,9 @@
 #include "vpcolorize.h"
 #include "customgui_lensglow.h"
 #include "main.h"
+#include "videopostids.h"
+#include "vpcolormatrix.h"
+#include "vpsequence.h"
 
 using namespace cinema;
 
@@ -18,8 +21,10 @@ class ColorizeData : public VideoPostData
 	INSTANCEOF(ColorizeData, VideoPostData)
 
 private:
-	VPBuffer* buf;
-	Float32		dr, dg, db;
+	VPBuffer*				buf;
+	Float32					matrix[3][4];	// colour transform, resolved once per frame sequence
+	Int32						maskcomp;			// line offset of the alpha or object buffer, NOTOK for the complete image
+	VPSequenceState sequence;			// the matrix is rebuilt when the settings change
 
 public:
 	virtual Bool Init(GeListNode* node, Bool isCloneInit);
@@ -37,6 +42,7 @@ Bool ColorizeData::Init(GeListNode* node, Bool isCloneInit)
 {
 	BaseVideoPost* pp	 = (BaseVideoPost*)node;
 	BaseContainer* dat = pp->GetDataInstance();
+	maskcomp = NOTOK;
 	if (!isCloneInit)
 	{
 		dat->SetFloat(VP_COLORIZE_DELTA_R, 0.2);
@@ -68,10 +74,13 @@ RENDERRESULT ColorizeData::Execute(BaseVideoPost* node, VideoPostStruct* vps)
 		Int32 obj	 = dat->GetInt32(VP_COLORIZE_OBJECTID, 1);
 		Int32 mode = dat->GetInt32(VP_COLORIZE_MODE);
 
-		// value caching for faster access
-		dr	= (Float32)dat->GetFloat(VP_COLORIZE_DELTA_R) + 1.0f;
-		dg	= (Float32)dat->GetFloat(VP_COLORIZE_DELTA_G) + 1.0f;
-		db	= (Float32)dat->GetFloat(VP_COLORIZE_DELTA_B) + 1.0f;
+		if (sequence.BeginSequence(node))
+		{
+			// value caching for faster access
+			SetColorizeMatrix(matrix, (Float32)dat->GetFloat(VP_COLORIZE_DELTA_R), (Float32)dat->GetFloat(VP_COLORIZE_DELTA_G), (Float32)dat->GetFloat(VP_COLORIZE_DELTA_B));
+		}
+
+		// the buffers belong to the render, they are looked up for every frame sequence
 		buf = nullptr;
 
 		switch (mode)
@@ -79,6 +88,9 @@ RENDERRESULT ColorizeData::Execute(BaseVideoPost* node, VideoPostStruct* vps)
 			case 1: buf = vps->render->GetBuffer(VPBUFFER_ALPHA, 0); break;
 			case 2: buf = vps->render->GetBuffer(VPBUFFER_OBJECTBUFFER, obj); break;
 		}
+
+		// the mode is resolved here, ExecuteLine doesn't need to check it per sample
+		maskcomp = buf ? buf->GetInfo(VPGETINFO::LINEOFFSET) : NOTOK;
 	}
 	else if (vps->vp == VIDEOPOSTCALL::INNER && !vps->open)
 	{
@@ -115,43 +127,15 @@ void ColorizeData::AllocateBuffers(BaseVideoPost* node, Render* render, BaseDocu
 
 void ColorizeData::ExecuteLine(BaseVideoPost* node, PixelPost* pp)
 {
-	Int32		 alphacomp = NOTOK;
-	Int32		 mul = pp->aa ? 4 : 1;
-	Float32* col = pp->col;
-	Float32	 grey, aa, na;
-	Int32		 i, x;
+	// the sub-samples of all pixels of the span are stored one after the other
+	const Int count = Int(pp->xmax - pp->xmin + 1) * (pp->aa ? 4 : 1);
+	if (count <= 0)
+		return;
 
-	if (buf)
-		alphacomp = buf->GetInfo(VPGETINFO::LINEOFFSET);
-
-	if (alphacomp != NOTOK)
-	{
-		for (x = pp->xmin; x <= pp->xmax; x++)
-		{
-			for (i = 0; i < mul; i++, col += pp->comp)
-			{
-				grey = (col[0] + col[1] + col[2]) / 3.0f;
-				aa = col[alphacomp];
-				na = 1.0f - aa;
-				col[0] = aa * grey * dr + na * col[0];
-				col[1] = aa * grey * dg + na * col[1];
-				col[2] = aa * grey * db + na * col[2];
-			}
-		}
-	}
+	if (maskcomp != NOTOK)
+		ApplyColorMatrixMasked(matrix, pp->col, count, pp->comp, maskcomp);
 	else
-	{
-		for (x = pp->xmin; x <= pp->xmax; x++)
-		{
-			for (i = 0; i < mul; i++, col += pp->comp)
-			{
-				grey = (col[0] + col[1] + col[2]) / 3.0f;
-				col[0] = grey * dr;
-				col[1] = grey * dg;
-				col[2] = grey * db;
-			}
-		}
-	}
+		ApplyColorMatrix(matrix, pp->col, count, pp->comp);
 }
 
 Bool ColorizeData::RenderEngineCheck(const BaseVideoPost* node, Int32 id) const
@@ -163,9 +147,6 @@ Bool ColorizeData::RenderEngineCheck(const BaseVideoPost* node, Int32 id) const
 	return true;
 }
 
-// be sure to use a unique ID obtained from www.plugincafe.com
-#define ID_COLORIZEVIDEOPOST 1000968
-
 Bool RegisterVPTest()
 {
 	return RegisterVideoPostPlugin(ID_COLORIZEVIDEOPOST, GeLoadString(IDS_VIDEOPOST), PLUGINFLAG_VIDEOPOST_MULTIPLE, ColorizeData::Alloc, "VPcolorize"_s, 0, 0);
@@ -0,0 +1,64 @@
+#ifndef VPCOLORMATRIX_H__
+#define VPCOLORMATRIX_H__
+
+#include "c4d.h"
+
+//----------------------------------------------------------------------------------------
+/// Sets the colour matrix of the colorize effect, every channel is the grey value
+/// (r + g + b) / 3 scaled by 1 + its delta.
+/// @param[out] m									The colour matrix.
+/// @param[in] deltaR							Delta of the red channel.
+/// @param[in] deltaG							Delta of the green channel.
+/// @param[in] deltaB							Delta of the blue channel.
+//----------------------------------------------------------------------------------------
+inline void SetColorizeMatrix(cinema::Float32 (&m)[3][4], cinema::Float32 deltaR, cinema::Float32 deltaG, cinema::Float32 deltaB)
+{
+	const cinema::Float32 delta[3] = { deltaR + 1.0f, deltaG + 1.0f, deltaB + 1.0f };
+
+	for (cinema::Int32 c = 0; c < 3; c++)
+	{
+		for (cinema::Int32 k = 0; k < 3; k++)
+			m[c][k] = delta[c] / 3.0f;
+		m[c][3] = 0.0f;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+/// Applies a 3x4 colour matrix to a span of samples, the fourth column is an offset.
+/// @param[in] m									The colour matrix.
+/// @param[in,out] col						First sample.
+/// @param[in] count							Number of samples.
+/// @param[in] comp								Components per sample.
+//----------------------------------------------------------------------------------------
+inline void ApplyColorMatrix(const cinema::Float32 (&m)[3][4], cinema::Float32* col, cinema::Int count, cinema::Int32 comp)
+{
+	for (cinema::Int i = 0; i < count; i++, col += comp)
+	{
+		const cinema::Float32 r = col[0], g = col[1], b = col[2];
+		col[0] = m[0][0] * r + m[0][1] * g + m[0][2] * b + m[0][3];
+		col[1] = m[1][0] * r + m[1][1] * g + m[1][2] * b + m[1][3];
+		col[2] = m[2][0] * r + m[2][1] * g + m[2][2] * b + m[2][3];
+	}
+}
+
+//----------------------------------------------------------------------------------------
+/// Blends a span of samples with their colour matrix result, the blend weight of a
+/// sample is the mask component (alpha or object buffer).
+/// @param[in] m									The colour matrix.
+/// @param[in,out] col						First sample.
+/// @param[in] count							Number of samples.
+/// @param[in] comp								Components per sample.
+/// @param[in] maskcomp						Offset of the mask component in a sample.
+//----------------------------------------------------------------------------------------
+inline void ApplyColorMatrixMasked(const cinema::Float32 (&m)[3][4], cinema::Float32* col, cinema::Int count, cinema::Int32 comp, cinema::Int32 maskcomp)
+{
+	for (cinema::Int i = 0; i < count; i++, col += comp)
+	{
+		const cinema::Float32 r = col[0], g = col[1], b = col[2], a = col[maskcomp];
+		col[0] = r + a * (m[0][0] * r + m[0][1] * g + m[0][2] * b + m[0][3] - r);
+		col[1] = g + a * (m[1][0] * r + m[1][1] * g + m[1][2] * b + m[1][3] - g);
+		col[2] = b + a * (m[2][0] * r + m[2][1] * g + m[2][2] * b + m[2][3] - b);
+	}
+}
+
+#endif // VPCOLORMATRIX_H__
@@ -0,0 +1,108 @@
+#include "vpfused.h"
+
+using namespace cinema;
+
+// number of rows that pass through the kernels at once
+#define FUSED_ROW_BLOCK 16
+
+static const VPFusedKernel* GetFusedKernel(BaseVideoPost* vp, VideoPostStruct* vps)
+{
+	if (!vp || vp->GetBit(BIT_VPDISABLED))
+		return nullptr;
+
+	VPFusedKernelData data;
+	data.vps = vps;
+	vp->Message(MSG_VPFUSED_GETKERNEL, &data);
+
+	return data.kernel;
+}
+
+static maxon::Result<void> ExecuteKernels(const VPFusedKernel* const* kernels, Int count, VideoPostStruct* vps, maxon::BaseArray<VPBlock>& pool)
+{
+	iferr_scope;
+
+	VPBuffer*						rgba = vps->render->GetBuffer(VPBUFFER_RGBA, NOTOK);
+	const RayParameter* ray	 = vps->vd->GetRayParameter();
+	if (!rgba || !ray)
+		return maxon::NullptrError(MAXON_SOURCE_LOCATION);
+
+	// the fragments of a block are fetched once for all kernels of the chain
+	VPGETFRAGMENTS fragmentFlags = VPGETFRAGMENTS::NONE;
+	for (Int i = 0; i < count; i++)
+		fragmentFlags |= kernels[i]->GetFragmentFlags();
+
+	VolumeData*			vd = vps->vd;
+	maxon::Spinlock fragmentLock;
+
+	// every row passes through all kernels while it is in the cache
+	ProcessRowBlocks(rgba, ray->left, ray->top, ray->right, ray->bottom, FUSED_ROW_BLOCK, 32, pool, vps->thread,
+		[kernels, count, fragmentFlags, vd, &fragmentLock](VPBlock& block) -> maxon::Result<void>
+		{
+			iferr_scope;
+
+			if (fragmentFlags != VPGETFRAGMENTS::NONE)
+				block.LoadFragments(vd, fragmentFlags, fragmentLock) iferr_return;
+
+			for (Int32 y = block.GetTop(); y <= block.GetBottom(); y++)
+			{
+				Float32* row = block.GetRow<Float32>(y);
+
+				const VPFragment** frag = block.GetFragments(y);
+				Bool							 changed = false;
+				for (Int i = 0; i < count; i++)
+					changed |= kernels[i]->ProcessRow(row, frag, block.GetLeft(), y, block.GetWidth(), block.GetComponents());
+
+				if (changed)
+					block.Touch(y);
+			}
+
+			block.FreeFragments();
+			return maxon::OK;
+		}) iferr_return;
+
+	return maxon::OK;
+}
+
+maxon::Result<void> ExecuteKernel(const VPFusedKernel& kernel, VideoPostStruct* vps, maxon::BaseArray<VPBlock>& pool)
+{
+	const VPFusedKernel* kernels = &kernel;
+	return ExecuteKernels(&kernels, 1, vps, pool);
+}
+
+static BaseVideoPost* GetPredEnabled(BaseVideoPost* vp)
+{
+	for (vp = vp->GetPred(); vp && vp->GetBit(BIT_VPDISABLED); vp = vp->GetPred()) { }
+	return vp;
+}
+
+maxon::Result<Bool> ExecuteFused(BaseVideoPost* node, VideoPostStruct* vps, maxon::BaseArray<VPBlock>& pool)
+{
+	iferr_scope;
+
+	const VPFusedKernel* kernel = GetFusedKernel(node, vps);
+	if (!kernel)
+		return false;
+
+	// the chain was already processed by its first video post
+	if (GetFusedKernel(GetPredEnabled(node), vps))
+		return true;
+
+	// a chain rarely has more than a few video posts, the kernels of a frame need no allocation
+	maxon::BufferedBaseArray<const VPFusedKernel*, 8> kernels;
+	kernels.Append(kernel) iferr_return;
+
+	for (BaseVideoPost* vp = node->GetNext(); vp; vp = vp->GetNext())
+	{
+		if (vp->GetBit(BIT_VPDISABLED))
+			continue;
+
+		kernel = GetFusedKernel(vp, vps);
+		if (!kernel)
+			break;
+		kernels.Append(kernel) iferr_return;
+	}
+
+	ExecuteKernels(kernels.GetFirst(), kernels.GetCount(), vps, pool) iferr_return;
+
+	return true;
+}
@@ -0,0 +1,74 @@
+#ifndef VPFUSED_H__
+#define VPFUSED_H__
+
+#include "c4d.h"
+#include "videopostids.h"
+#include "vpblock.h"
+
+// message sent to a video post to get its fused kernel, data is VPFusedKernelData
+#define MSG_VPFUSED_GETKERNEL ID_MSG_VPFUSED
+
+//----------------------------------------------------------------------------------------
+/// A per-pixel effect of a video post that can run in a fused pass.
+/// Only effects that work on the finished image in VIDEOPOSTCALL::RENDER can be fused,
+/// effects of ExecuteLine run before the lens effects and would change their order.
+//----------------------------------------------------------------------------------------
+class VPFusedKernel
+{
+public:
+	//----------------------------------------------------------------------------------------
+	/// Returns the fragment data the kernel needs, the pass fetches the fragments of a block once for all kernels.
+	/// @return												The flags for VolumeData::GetFragments(), VPGETFRAGMENTS::NONE if the kernel needs no fragments.
+	//----------------------------------------------------------------------------------------
+	virtual cinema::VPGETFRAGMENTS GetFragmentFlags() const { return cinema::VPGETFRAGMENTS::NONE; }
+
+	//----------------------------------------------------------------------------------------
+	/// Processes a row of the RGBA buffer.
+	/// Called concurrently for different rows.
+	/// @param[in,out] row						The pixels, 32 bit.
+	/// @param[in] frag								The fragment lists of the pixels, nullptr if GetFragmentFlags() requested none or the row has none.
+	/// @param[in] x1									Column of the first pixel.
+	/// @param[in] y									Row.
+	/// @param[in] cnt								Number of pixels.
+	/// @param[in] cpp								Components per pixel.
+	/// @return												True if the row was changed.
+	//----------------------------------------------------------------------------------------
+	virtual cinema::Bool ProcessRow(cinema::Float32* row, const cinema::VPFragment** frag, cinema::Int32 x1, cinema::Int32 y, cinema::Int32 cnt, cinema::Int32 cpp) const = 0;
+};
+
+//----------------------------------------------------------------------------------------
+/// Data of MSG_VPFUSED_GETKERNEL. A video post that takes part in the fused pass
+/// prepares its kernel for the render and sets kernel.
+//----------------------------------------------------------------------------------------
+struct VPFusedKernelData
+{
+	cinema::VideoPostStruct*	vps = nullptr;			// the current render
+	const VPFusedKernel*			kernel = nullptr;
+};
+
+//----------------------------------------------------------------------------------------
+/// Runs a single kernel over the render region of the RGBA buffer, the pass of a video post
+/// that is not part of a fused chain.
+/// Has to be called in VIDEOPOSTCALL::RENDER after the image was rendered.
+/// @param[in] kernel							The kernel.
+/// @param[in] vps								The current render.
+/// @param[in,out] pool						Blocks of the workers, see ProcessRowBlocks().
+/// @return												OK on success.
+//----------------------------------------------------------------------------------------
+maxon::Result<void> ExecuteKernel(const VPFusedKernel& kernel, cinema::VideoPostStruct* vps, maxon::BaseArray<VPBlock>& pool);
+
+//----------------------------------------------------------------------------------------
+/// Runs the effect of a video post in a fused pass. Consecutive enabled video posts that
+/// answer MSG_VPFUSED_GETKERNEL form a chain. The first video post of the chain streams the
+/// RGBA buffer block by block through the kernels of all of them, the following video posts
+/// of the chain have nothing left to do.
+/// Has to be called in VIDEOPOSTCALL::RENDER after the image was rendered.
+/// @param[in] node								The video post.
+/// @param[in] vps								The current render.
+/// @param[in,out] pool						Blocks of the workers, see ProcessRowBlocks().
+/// @return												True if the effect of the video post was applied by a fused pass,
+/// 															false if the video post is not part of a chain.
+//----------------------------------------------------------------------------------------
+maxon::Result<cinema::Bool> ExecuteFused(cinema::BaseVideoPost* node, cinema::VideoPostStruct* vps, maxon::BaseArray<VPBlock>& pool);
+
+#endif // VPFUSED_H__
@@ -6,71 +6,144 @@
 #include "c4d.h"
 #include "c4d_symbols.h"
 #include "main.h"
+#include "vpfused.h"
+#include "vpinvertimage.h"
 
 using namespace cinema;
 
+// the per-pixel effect, run by Execute or as part of a fused pass
+class InvertKernel : public VPFusedKernel
+{
+public:
+	virtual Bool ProcessRow(Float32* row, const VPFragment** frag, Int32 x1, Int32 y, Int32 cnt, Int32 cpp) const
+	{
+		for (Int32 x = 0; x < cnt; x++, row += cpp)
+		{
+			for (Int32 i = 0; i < 3; i++)
+				row[i] = 1.0f - row[i];
+		}
+		return true;
+	}
+};
+
+// number of rows of a block of the native pass
+#define INVERT_ROW_BLOCK 16
+
+// inverts the colour of a row in the representation of the buffer, max - x is the
+// complement of all bits for UChar and UInt16
+template <typename T> static void InvertRowNative(T* row, Int cnt, Int32 cpp)
+{
+	if (cpp == 4)
+	{
+		// RGBA rows, alpha is kept
+		for (Int x = 0; x < cnt; x++, row += 4)
+		{
+			row[0] = T(~row[0]);
+			row[1] = T(~row[1]);
+			row[2] = T(~row[2]);
+		}
+	}
+	else
+	{
+		for (Int x = 0; x < cnt; x++, row += cpp)
+		{
+			for (Int32 i = 0; i < 3; i++)
+				row[i] = T(~row[i]);
+		}
+	}
+}
+
 class InvertData : public VideoPostData
 {
 public:
 	static NodeData* Alloc() { return NewObjClear(InvertData); }
+	virtual Bool Init(GeListNode* node, Bool isCloneInit);
 	virtual RENDERRESULT Execute(BaseVideoPost* node, VideoPostStruct* vps);
 	virtual void Free(GeListNode* node);
 	virtual VIDEOPOSTINFO GetRenderInfo(BaseVideoPost* node) { return VIDEOPOSTINFO::NONE; }
 	virtual Bool RenderEngineCheck(const BaseVideoPost* node, Int32 id) const;
 	virtual Bool Message(GeListNode *node, Int32 type, void *data);
+
+private:
+	maxon::Result<Bool> ExecuteNative(VideoPostStruct* vps);
+
+	// row blocks of the workers, kept for the frames of a sequence and freed when it ends
+	maxon::BaseArray<VPBlock> _blocks;
+	InvertKernel							_kernel;
 };
 
-RENDERRESULT InvertData::Execute(BaseVideoPost* node, VideoPostStruct* vps)
+Bool InvertData::Init(GeListNode* node, Bool isCloneInit)
 {
-	if (vps->vp == VIDEOPOSTCALL::RENDER && !vps->open && *vps->error == RENDERRESULT::OK && !vps->thread->TestBreak())
+	BaseContainer* dat = static_cast<BaseVideoPost*>(node)->GetDataInstance();
+	if (!isCloneInit)
 	{
-		VPBuffer*			rgba = vps->render->GetBuffer(VPBUFFER_RGBA, NOTOK);
-		const RayParameter* ray	 = vps->vd->GetRayParameter();	// only in VP_INNER & VIDEOPOSTCALL::RENDER
-		if (!ray)
-			return RENDERRESULT::OUTOFMEMORY;
-		if (!rgba)
-			return RENDERRESULT::OUTOFMEMORY;
-
-		Int32 x1, y1, x2, y2, x, y, cnt, i;
-
-		// example functions
-		Int32 cpp = rgba->GetInfo(VPGETINFO::CPP);
+		dat->SetBool(VP_INVERTIMAGE_FUSE, false);
+	}
 
-		x1	= ray->left;
-		y1	= ray->top;
-		x2	= ray->right;
-		y2	= ray->bottom;
-		cnt = x2 - x1 + 1;
+	return true;
+}
 
-		Int			 bufferSize = cpp * cnt;
-		Float32* b, *buffer = nullptr;
+RENDERRESULT InvertData::Execute(BaseVideoPost* node, VideoPostStruct* vps)
+{
+	if (vps->vp == VIDEOPOSTCALL::FRAMESEQUENCE && !vps->open)
+	{
+		_blocks.Reset();
+	}
+	else if (vps->vp == VIDEOPOSTCALL::RENDER && !vps->open && *vps->error == RENDERRESULT::OK && !vps->thread->TestBreak())
+	{
+		// a fused pass of a chain of effects replaces the own pass
+		Bool done = false;
+		iferr (done = ExecuteFused(node, vps, _blocks))
+			return GetPassResult(err);
 
-		if (bufferSize > 0)
+		// 8 and 16 bit images are inverted without a conversion to float
+		if (!done)
 		{
-			iferr (buffer = NewMemClear(Float32, bufferSize))
-				return RENDERRESULT::OUTOFMEMORY;
+			iferr (done = ExecuteNative(vps))
+				return GetPassResult(err);
 		}
-		if (!buffer)
-			return RENDERRESULT::OUTOFMEMORY;
 
-		for (y = y1; y <= y2; y++)
+		if (!done)
 		{
-			rgba->GetLine(x1, y, cnt, buffer, 32, true);
-
-			for (b = buffer, x = x1; x <= x2; x++, b += cpp)
-			{
-				for (i = 0; i < 3; i++)
-					b[i] = 1.0f - b[i];
-			}
-
-			rgba->SetLine(x1, y, cnt, buffer, 32, true);
+			iferr (ExecuteKernel(_kernel, vps, _blocks))
+				return GetPassResult(err);
 		}
-		DeleteMem(buffer);
 	}
 
 	return RENDERRESULT::OK;
 }
 
+maxon::Result<Bool> InvertData::ExecuteNative(VideoPostStruct* vps)
+{
+	iferr_scope;
+
+	VPBuffer*						rgba = vps->render->GetBuffer(VPBUFFER_RGBA, NOTOK);
+	const RayParameter* ray	 = vps->vd->GetRayParameter();
+	if (!rgba || !ray)
+		return maxon::NullptrError(MAXON_SOURCE_LOCATION);
+
+	// HDR images take the float path of the kernel
+	const Int32 bitdepth = (Int32)rgba->GetInfo(VPGETINFO::BITDEPTH);
+	if (bitdepth != 8 && bitdepth != 16)
+		return false;
+
+	ProcessRowBlocks(rgba, ray->left, ray->top, ray->right, ray->bottom, INVERT_ROW_BLOCK, bitdepth, _blocks, vps->thread,
+		[](VPBlock& block) -> maxon::Result<void>
+		{
+			for (Int32 y = block.GetTop(); y <= block.GetBottom(); y++)
+			{
+				if (block.GetBitDepth() == 8)
+					InvertRowNative(block.GetRow<UChar>(y), block.GetWidth(), block.GetComponents());
+				else
+					InvertRowNative(block.GetRow<UInt16>(y), block.GetWidth(), block.GetComponents());
+				block.Touch(y);
+			}
+			return maxon::OK;
+		}) iferr_return;
+
+	return true;
+}
+
 void InvertData::Free(GeListNode* node)
 {
 }
@@ -87,18 +160,24 @@ Bool InvertData::Message(GeListNode *node, Int32 type, void *data)
 	switch (type)
 	{
 		case MSG_GET_VIEWPORT_RENDER_ID:
+		{
 			ViewportRenderIDMessageData* msgData = (ViewportRenderIDMessageData*) data;
 			msgData->viewportId = "invert";
 			break;
+		}
+		case MSG_VPFUSED_GETKERNEL:
+		{
+			VPFusedKernelData* fusedData = (VPFusedKernelData*) data;
+			if (static_cast<BaseVideoPost*>(node)->GetDataInstance()->GetBool(VP_INVERTIMAGE_FUSE))
+				fusedData->kernel = &_kernel;
+			break;
+		}
 	}
 			
 	return VideoPostData::Message(node, type, data);
 }
 
-// be sure to use a unique ID obtained from www.plugincafe.com
-#define ID_INVERTVIDEOPOST 1000455
-
 Bool RegisterVPInvertImage()
 {
-	return RegisterVideoPostPlugin(ID_INVERTVIDEOPOST, GeLoadString(IDS_VPINVERTIMAGE), 0, InvertData::Alloc, String(), 0, 0);
+	return RegisterVideoPostPlugin(ID_INVERTVIDEOPOST, GeLoadString(IDS_VPINVERTIMAGE), 0, InvertData::Alloc, "VPinvertimage"_s, 0, 0);
 }
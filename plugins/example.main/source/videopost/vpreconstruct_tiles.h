@@ -0,0 +1,173 @@
+#ifndef VPRECONSTRUCT_TILES_H__
+#define VPRECONSTRUCT_TILES_H__
+
+#include "maxon/atomictypes.h"
+#include "maxon/parallelfor.h"
+#include "c4d.h"
+
+//----------------------------------------------------------------------------------------
+/// Writes the reconstructed colors of a row, pixels without fragments are not changed.
+/// @param[in] frag								Fragment lists of cnt pixels as returned by VolumeData::GetFragments().
+/// @param[in] cnt								Number of pixels of the row.
+/// @param[in,out] buffer					Line of cnt pixels with cpp components each.
+/// @param[in] cpp								Components per pixel.
+//----------------------------------------------------------------------------------------
+template <typename FRAGMENT> void ResolveFragmentRow(const FRAGMENT* const* frag, cinema::Int32 cnt, cinema::Float32* buffer, cinema::Int32 cpp)
+{
+	for (cinema::Int32 x = 0; x < cnt; x++, buffer += cpp)
+	{
+		if (!frag[x])
+			continue;		// unchanged background pixel
+
+		cinema::Vector32 col = cinema::Vector32(0.0);
+		for (const FRAGMENT* f = frag[x]; f; f = f->next)
+			col += cinema::Float32(f->weight) * f->color;
+
+		col /= (cinema::Float32) 256.0;
+		buffer[0] = col.x;
+		buffer[1] = col.y;
+		buffer[2] = col.z;
+	}
+}
+
+//----------------------------------------------------------------------------------------
+/// Memory of a worker of ReconstructTiles(), the line buffer and the fragment lists of a tile.
+/// The memory is kept when the arena is prepared again, so once the arenas have seen the
+/// first frame the tiles of the following frames are reconstructed without allocations.
+//----------------------------------------------------------------------------------------
+template <typename FRAGMENT> class FragmentArena
+{
+public:
+	//----------------------------------------------------------------------------------------
+	/// Makes room for a tile.
+	/// @param[in] rows								Number of rows of the tile.
+	/// @param[in] cnt								Number of pixels per row.
+	/// @param[in] cpp								Components per pixel.
+	/// @return												OK on success.
+	//----------------------------------------------------------------------------------------
+	maxon::Result<void> Prepare(cinema::Int32 rows, cinema::Int32 cnt, cinema::Int32 cpp)
+	{
+		iferr_scope;
+
+		_line.Resize(cinema::Int(cnt) * cpp, maxon::COLLECTION_RESIZE_FLAGS::ON_SHRINK_KEEP_CAPACITY | maxon::COLLECTION_RESIZE_FLAGS::POD_UNINITIALIZED) iferr_return;
+		_fragments.Resize(rows, maxon::COLLECTION_RESIZE_FLAGS::ON_SHRINK_KEEP_CAPACITY | maxon::COLLECTION_RESIZE_FLAGS::POD_UNINITIALIZED) iferr_return;
+
+		return maxon::OK;
+	}
+
+	cinema::Float32* GetLine() { return _line.GetFirst(); }
+
+	// the fragment lists of the rows of the tile, filled by the source
+	const FRAGMENT*** GetFragments() { return _fragments.GetFirst(); }
+
+	//----------------------------------------------------------------------------------------
+	/// Frees all data.
+	//----------------------------------------------------------------------------------------
+	void Reset()
+	{
+		_line.Reset();
+		_fragments.Reset();
+	}
+
+private:
+	maxon::BaseArray<cinema::Float32>	 _line;
+	maxon::BaseArray<const FRAGMENT**> _fragments;
+};
+
+//----------------------------------------------------------------------------------------
+/// Reconstructs the rows y1..y2 from their fragments. The rows are split into tiles
+/// of rowsPerTile rows which are processed concurrently. Every worker uses the arena of
+/// the pool with its index, the pool grows to the number of threads and is meant to be
+/// kept by the video post from frame to frame.
+/// SOURCE is called concurrently for different tiles and has to provide
+/// 	void GetFragments(Int32 y, Int32 rows, const FRAGMENT*** frag) for all rows of a tile,
+/// 	void FreeFragments(const FRAGMENT** frag) for a row,
+/// 	void GetLine(Int32 y, Float32* buffer) and void SetLine(Int32 y, Float32* buffer).
+/// Rows without fragments are neither read nor written.
+/// @param[in] source							Access to the image and its fragments.
+/// @param[in] y1									First row.
+/// @param[in] y2									Last row.
+/// @param[in] cnt								Number of pixels per row.
+/// @param[in] cpp								Components per pixel of the lines.
+/// @param[in] rowsPerTile				Number of rows per tile.
+/// @param[in,out] arenas					Pool of arenas of the workers.
+/// @param[in] thread							Checked for a break before every tile, may be nullptr.
+/// @return												OK on success, OperationCancelledError if tiles were skipped because of a break.
+//----------------------------------------------------------------------------------------
+template <typename SOURCE, typename FRAGMENT> maxon::Result<void> ReconstructTiles(SOURCE& source, cinema::Int32 y1, cinema::Int32 y2, cinema::Int32 cnt, cinema::Int32 cpp, cinema::Int32 rowsPerTile, maxon::BaseArray<FragmentArena<FRAGMENT>>& arenas, cinema::BaseThread* thread)
+{
+	iferr_scope;
+
+	if (y2 < y1 || cnt <= 0 || cpp < 3 || rowsPerTile <= 0)
+		return maxon::OK;
+
+	const cinema::Int threadCount = maxon::ThreadRef::GetCurrentThreadCount();
+	if (arenas.GetCount() < threadCount)
+		arenas.Resize(threadCount) iferr_return;
+
+	struct ReconstructContext : public maxon::ParallelFor::BaseContext
+	{
+		FragmentArena<FRAGMENT>* arena = nullptr;
+		FragmentArena<FRAGMENT>	 local;		// only used if the pool has no arena for this worker
+	};
+
+	const cinema::Int32 tileCount = (y2 - y1 + rowsPerTile) / rowsPerTile;
+	maxon::AtomicBool		failed, broken;
+
+	maxon::ParallelFor::Dynamic<ReconstructContext>(0, tileCount,
+		[&arenas](ReconstructContext& context)
+		{
+			const cinema::Int index = context.GetLocalThreadIndex();
+			context.arena = index < arenas.GetCount() ? &arenas[index] : &context.local;
+		},
+		[&source, &failed, &broken, thread, y1, y2, cnt, cpp, rowsPerTile](cinema::Int tile, ReconstructContext& context)
+		{
+			if (failed.Get())
+				return;
+
+			if (thread && thread->TestBreak())
+			{
+				broken.Set(true);
+				return;
+			}
+
+			const cinema::Int32			 yStart = y1 + cinema::Int32(tile) * rowsPerTile;
+			const cinema::Int32			 rows = maxon::Min(y2 - yStart + 1, rowsPerTile);
+			FragmentArena<FRAGMENT>& arena = *context.arena;
+
+			iferr (arena.Prepare(rows, cnt, cpp))
+			{
+				failed.Set(true);
+				return;
+			}
+
+			const FRAGMENT*** frag = arena.GetFragments();
+			cinema::Float32*	buffer = arena.GetLine();
+			source.GetFragments(yStart, rows, frag);
+
+			for (cinema::Int32 i = 0; i < rows; i++)
+			{
+				if (!frag[i])
+					continue;
+
+				source.GetLine(yStart + i, buffer);
+				ResolveFragmentRow(frag[i], cnt, buffer, cpp);
+				source.FreeFragments(frag[i]);
+				source.SetLine(yStart + i, buffer);
+			}
+		},
+		[](ReconstructContext& context)
+		{
+		}, maxon::ParallelFor::Granularity(1));
+
+	if (failed.Get())
+		return maxon::OutOfMemoryError(MAXON_SOURCE_LOCATION);
+
+	// the skipped tiles were not reconstructed, the image is incomplete
+	if (broken.Get())
+		return maxon::OperationCancelledError(MAXON_SOURCE_LOCATION);
+
+	return maxon::OK;
+}
+
+#endif // VPRECONSTRUCT_TILES_H__
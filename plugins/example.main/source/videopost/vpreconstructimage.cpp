@@ -4,9 +4,14 @@
 #include "c4d.h"
 #include "c4d_symbols.h"
 #include "main.h"
+#include "vpblock.h"
+#include "vpreconstruct_tiles.h"
 
 using namespace cinema;
 
+// number of rows a worker reconstructs at once
+#define RECONSTRUCT_TILE_ROWS 16
+
 class ReconstructData : public VideoPostData
 {
 public:
@@ -14,10 +19,52 @@ public:
 	virtual RENDERRESULT Execute(BaseVideoPost* node, VideoPostStruct* vps);
 	virtual VIDEOPOSTINFO GetRenderInfo(BaseVideoPost* node) { return VIDEOPOSTINFO::STOREFRAGMENTS; }
 	virtual Bool RenderEngineCheck(const BaseVideoPost* node, Int32 id) const;
+
+private:
+	// fragment arenas of the workers, sized by the first frame and freed when the frame sequence ends
+	maxon::BaseArray<FragmentArena<VPFragment>> _arenas;
+};
+
+// access to the rgba buffer and the fragments of the current render for ReconstructTiles()
+struct ReconstructSource
+{
+	VPBuffer*		rgba;
+	VolumeData* vd;
+	Render*			render;
+	Int32				x1, cnt, cpp;
+
+	// the same policy as the row blocks of the other video posts: VolumeData is shared by all
+	// workers and GetFragments is not documented to be thread-safe, so the fragments of a tile
+	// are fetched at once under the lock, see VPBlock::LoadFragments(). The workers read and
+	// write different rows of the buffer and convert their own line, like VPBlock::Load() and
+	// VPBlock::Store() this needs no lock.
+	mutable maxon::Spinlock fragmentLock;
+
+	void GetFragments(Int32 y, Int32 rows, const VPFragment*** frag) const
+	{
+		maxon::ScopedLock guard(fragmentLock);
+		for (Int32 i = 0; i < rows; i++)
+			frag[i] = vd->GetFragments(x1, y + i, cnt, VPGETFRAGMENTS::Z_P | VPGETFRAGMENTS::N);
+	}
+
+	void FreeFragments(const VPFragment** frag) const { DeleteMem(frag); }
+	void GetLine(Int32 y, Float32* buffer) const { rgba->GetLine(x1, y, cnt, buffer, 32, true); }
+
+	void SetLine(Int32 y, Float32* buffer) const
+	{
+		render->IccConvert(buffer, cnt, cpp, false);
+		rgba->SetLine(x1, y, cnt, buffer, 32, true);
+	}
 };
 
 RENDERRESULT ReconstructData::Execute(BaseVideoPost* node, VideoPostStruct* vps)
 {
+	if (vps->vp == VIDEOPOSTCALL::FRAMESEQUENCE && !vps->open)
+	{
+		_arenas.Reset();
+		return RENDERRESULT::OK;
+	}
+
 	if (vps->vp != VIDEOPOSTCALL::RENDER || vps->open || *vps->error != RENDERRESULT::OK || vps->thread->TestBreak())
 		return RENDERRESULT::OK;
 
@@ -28,57 +75,19 @@ RENDERRESULT ReconstructData::Execute(BaseVideoPost* node, VideoPostStruct* vps)
 	if (!rgba)
 		return RENDERRESULT::OUTOFMEMORY;
 
-	Int32 x1, y1, x2, y2, x, y, cnt;
-
-	// example functions
-	Int32 cpp = rgba->GetInfo(VPGETINFO::CPP);
-
-	x1	= ray->left;
-	y1	= ray->top;
-	x2	= ray->right;
-	y2	= ray->bottom;
-	cnt = x2 - x1 + 1;
+	ReconstructSource source;
+	source.rgba		= rgba;
+	source.vd			= vps->vd;
+	source.render = vps->render;
+	source.cpp		= rgba->GetInfo(VPGETINFO::CPP);
+	source.x1			= ray->left;
+	source.cnt		= ray->right - ray->left + 1;
 
-	Int			 bufferSize = cpp * cnt;
-	Float32* b, *buffer = nullptr;
-
-	if (bufferSize > 0)
-	{
-		iferr (NewMemClear(Float32, bufferSize))
-			return RENDERRESULT::OUTOFMEMORY;
-	}
-	if (!buffer)
+	if (source.cnt <= 0 || source.cpp < 3)
 		return RENDERRESULT::OUTOFMEMORY;
 
-	for (y = y1; y <= y2; y++)
-	{
-		rgba->GetLine(x1, y, cnt, buffer, 32, true);
-
-		const VPFragment** frag = vps->vd->GetFragments(x1, y, cnt, VPGETFRAGMENTS::Z_P | VPGETFRAGMENTS::N), ** ind = frag;
-		if (!frag)
-			continue;
-
-		for (b = buffer, x = x1; x <= x2; x++, b += cpp, ind++)
-		{
-			Vector32		col = Vector32(0.0);
-			const VPFragment* f;
-			for (f = (*ind); f; f = f->next)
-				col += Float32(f->weight) * f->color;
-
-			if (!(*ind))
-				continue;		// unchanged background pixel
-			col /= (Float32) 256.0;
-			b[0] = col.x;
-			b[1] = col.y;
-			b[2] = col.z;
-		}
-
-		DeleteMem(frag);
-
-		vps->render->IccConvert(buffer, cnt, cpp, false);
-		rgba->SetLine(x1, y, cnt, buffer, 32, true);
-	}
-	DeleteMem(buffer);
+	iferr (ReconstructTiles(source, ray->top, ray->bottom, source.cnt, source.cpp, RECONSTRUCT_TILE_ROWS, _arenas, vps->thread))
+		return GetPassResult(err);
 
 	return RENDERRESULT::OK;
 }
@@ -0,0 +1,43 @@
+#ifndef VPSEQUENCE_H__
+#define VPSEQUENCE_H__
+
+#include "c4d.h"
+
+//----------------------------------------------------------------------------------------
+/// Tracks the settings of a video post from one frame sequence to the next.
+/// Every animation, batch and interactive render starts a frame sequence. Values that
+/// are derived from the settings only (e.g. a colour matrix) are kept between them and
+/// only rebuilt when the settings changed. Scratch memory depends on the resolution and
+/// the thread count of the render, not on the settings. It is kept for the frames of a
+/// sequence and freed when the frame sequence ends.
+//----------------------------------------------------------------------------------------
+class VPSequenceState
+{
+public:
+	//----------------------------------------------------------------------------------------
+	/// Checks the settings, has to be called in VIDEOPOSTCALL::FRAMESEQUENCE when it is opened.
+	/// @param[in] node								The video post.
+	/// @return												True if the settings changed since the last frame sequence.
+	//----------------------------------------------------------------------------------------
+	cinema::Bool BeginSequence(const cinema::BaseVideoPost* node)
+	{
+		const cinema::UInt dirty = node->GetDirty(cinema::DIRTYFLAGS::DATA);
+		const cinema::Bool changed = !_valid || dirty != _dirty;
+
+		_dirty = dirty;
+		_valid = true;
+
+		return changed;
+	}
+
+	//----------------------------------------------------------------------------------------
+	/// Forces a rebuild in the next frame sequence.
+	//----------------------------------------------------------------------------------------
+	void Invalidate() { _valid = false; }
+
+private:
+	cinema::UInt _dirty = 0;
+	cinema::Bool _valid = false;
+};
+
+#endif // VPSEQUENCE_H__
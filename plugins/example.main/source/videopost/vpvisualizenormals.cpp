@@ -4,78 +4,88 @@
 #include "c4d.h"
 #include "c4d_symbols.h"
 #include "main.h"
+#include "vpfused.h"
+#include "vpvisualizenormals.h"
 
 using namespace cinema;
 
-class VisualizePostData : public VideoPostData
+// the per-pixel effect, run by Execute or as part of a fused pass
+class VisualizeKernel : public VPFusedKernel
 {
 public:
-	static NodeData* Alloc() { return NewObjClear(VisualizePostData); }
-	virtual Bool RenderEngineCheck(const BaseVideoPost* node, Int32 id) const;
-	virtual RENDERRESULT Execute(BaseVideoPost* node, VideoPostStruct* vps);
-	virtual VIDEOPOSTINFO GetRenderInfo(BaseVideoPost* node) { return VIDEOPOSTINFO::STOREFRAGMENTS; }
-};
+	virtual VPGETFRAGMENTS GetFragmentFlags() const { return VPGETFRAGMENTS::Z_P | VPGETFRAGMENTS::N; }
 
-RENDERRESULT VisualizePostData::Execute(BaseVideoPost* node, VideoPostStruct* vps)
-{
-	if (vps->vp == VIDEOPOSTCALL::RENDER && !vps->open && *vps->error == RENDERRESULT::OK && !vps->thread->TestBreak())
+	virtual Bool ProcessRow(Float32* row, const VPFragment** frag, Int32 x1, Int32 y, Int32 cnt, Int32 cpp) const
 	{
-		VPBuffer*			rgba = vps->render->GetBuffer(VPBUFFER_RGBA, NOTOK);
-		const RayParameter* ray	 = vps->vd->GetRayParameter();	// only in VP_INNER & VIDEOPOSTCALL::RENDER
-		if (!ray)
-			return RENDERRESULT::OUTOFMEMORY;
-		if (!rgba)
-			return RENDERRESULT::OUTOFMEMORY;
+		// the fragment lists of the block are fetched by the pass, see VPBlock::LoadFragments()
+		if (!frag)
+			return false;
 
-		Int32 x1, y1, x2, y2, x, y, cnt;
+		const VPFragment** ind = frag;
 
-		// example functions
-		Int32 cpp = rgba->GetInfo(VPGETINFO::CPP);
-
-		x1	= ray->left;
-		y1	= ray->top;
-		x2	= ray->right;
-		y2	= ray->bottom;
-		cnt = x2 - x1 + 1;
+		for (Int32 x = 0; x < cnt; x++, row += cpp, ind++)
+		{
+			Vector32		col = Vector32(0.0);
+			const VPFragment* f;
+			for (f = (*ind); f; f = f->next)
+				col += (Vector32((Float32)Abs(f->n.x), (Float32)Abs(f->n.y), (Float32)Abs(f->n.z)) * f->weight) * f->color;
 
-		Int			 bufferSize = cpp * cnt;
-		Float32* b, *buffer = nullptr;
+			col /= (Float32) 256.0;
 
-		if (bufferSize > 0)
-		{
-			iferr (buffer = NewMemClear(Float32, bufferSize))
-				return RENDERRESULT::OUTOFMEMORY;
+			row[0] = col.x;
+			row[1] = col.y;
+			row[2] = col.z;
 		}
-		if (!buffer)
-			return RENDERRESULT::OUTOFMEMORY;
 
-		for (y = y1; y <= y2; y++)
-		{
-			rgba->GetLine(x1, y, cnt, buffer, 32, true);
+		return true;
+	}
+};
 
-			const VPFragment** frag = vps->vd->GetFragments(x1, y, cnt, VPGETFRAGMENTS::Z_P | VPGETFRAGMENTS::N), ** ind = frag;
-			if (!frag)
-				continue;
+class VisualizePostData : public VideoPostData
+{
+public:
+	static NodeData* Alloc() { return NewObjClear(VisualizePostData); }
+	virtual Bool Init(GeListNode* node, Bool isCloneInit);
+	virtual Bool RenderEngineCheck(const BaseVideoPost* node, Int32 id) const;
+	virtual RENDERRESULT Execute(BaseVideoPost* node, VideoPostStruct* vps);
+	virtual VIDEOPOSTINFO GetRenderInfo(BaseVideoPost* node) { return VIDEOPOSTINFO::STOREFRAGMENTS; }
+	virtual Bool Message(GeListNode* node, Int32 type, void* data);
 
-			for (b = buffer, x = x1; x <= x2; x++, b += cpp, ind++)
-			{
-				Vector32		col = Vector32(0.0);
-				const VPFragment* f;
-				for (f = (*ind); f; f = f->next)
-					col += (Vector32((Float32)Abs(f->n.x), (Float32)Abs(f->n.y), (Float32)Abs(f->n.z)) * f->weight) * f->color;
+private:
+	// row blocks of the workers, kept for the frames of a sequence and freed when it ends
+	maxon::BaseArray<VPBlock> _blocks;
+	VisualizeKernel						_kernel;
+};
 
-				col /= (Float32) 256.0;
+Bool VisualizePostData::Init(GeListNode* node, Bool isCloneInit)
+{
+	BaseContainer* dat = static_cast<BaseVideoPost*>(node)->GetDataInstance();
+	if (!isCloneInit)
+	{
+		dat->SetBool(VP_VISUALIZENORMALS_FUSE, false);
+	}
 
-				b[0] = col.x;
-				b[1] = col.y;
-				b[2] = col.z;
-			}
+	return true;
+}
 
-			DeleteMem(frag);
+RENDERRESULT VisualizePostData::Execute(BaseVideoPost* node, VideoPostStruct* vps)
+{
+	if (vps->vp == VIDEOPOSTCALL::FRAMESEQUENCE && !vps->open)
+	{
+		_blocks.Reset();
+	}
+	else if (vps->vp == VIDEOPOSTCALL::RENDER && !vps->open && *vps->error == RENDERRESULT::OK && !vps->thread->TestBreak())
+	{
+		// a fused pass of a chain of effects replaces the own pass
+		Bool fused = false;
+		iferr (fused = ExecuteFused(node, vps, _blocks))
+			return GetPassResult(err);
 
-			rgba->SetLine(x1, y, cnt, buffer, 32, true);
+		if (!fused)
+		{
+			iferr (ExecuteKernel(_kernel, vps, _blocks))
+				return GetPassResult(err);
 		}
-		DeleteMem(buffer);
 	}
 
 	return RENDERRESULT::OK;
@@ -90,10 +100,23 @@ Bool VisualizePostData::RenderEngineCheck(const BaseVideoPost* node, Int32 id) c
 	return true;
 }
 
-// be sure to use a unique ID obtained from www.plugincafe.com
-#define ID_VISUALIZENORMALS 1000986
+Bool VisualizePostData::Message(GeListNode* node, Int32 type, void* data)
+{
+	switch (type)
+	{
+		case MSG_VPFUSED_GETKERNEL:
+		{
+			VPFusedKernelData* fusedData = (VPFusedKernelData*) data;
+			if (static_cast<BaseVideoPost*>(node)->GetDataInstance()->GetBool(VP_VISUALIZENORMALS_FUSE))
+				fusedData->kernel = &_kernel;
+			break;
+		}
+	}
+
+	return VideoPostData::Message(node, type, data);
+}
 
 Bool RegisterVPVisualizeNormals()
 {
-	return RegisterVideoPostPlugin(ID_VISUALIZENORMALS, GeLoadString(IDS_VPVISUALIZEPOST), 0, VisualizePostData::Alloc, String(), 0, 0);
+	return RegisterVideoPostPlugin(ID_VISUALIZENORMALS, GeLoadString(IDS_VPVISUALIZEPOST), 0, VisualizePostData::Alloc, "VPvisualizenormals"_s, 0, 0);
 }